@@ -1,12 +1,240 @@
 #include "src/ui/mainwindow.h"
+#include "weatherservice.h"
+#include "dbmanager.h"
+#include "dbbackup.h"
+#include "dbreadpool.h"
+#include "jsonhelper.h"
+#include "chartexportjob.h"
+#include "columnarhistory.h"
 #include <QApplication>
+#include <QCoreApplication>
+#include <QGuiApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <limits>
+
+namespace {
+
+// 【新增】--backup-every <小时>: 定时写压缩快照到程序目录下的 backups/，保留最新 7 份 (界面和服务模式都可用)
+void startScheduledBackup(DBBackup &backup, int argc, char *argv[])
+{
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (QByteArray(argv[i]) == "--backup-every") {
+            bool ok = false;
+            int hours = QByteArray(argv[i + 1]).toInt(&ok);
+            // QTimer 的间隔是 int 毫秒，最多约 596 小时，超过的直接拒绝 (不能让它溢出成负数)
+            const qint64 intervalMs = qint64(hours) * 60 * 60 * 1000;
+            if (!ok || hours <= 0 || intervalMs > std::numeric_limits<int>::max()) {
+                qDebug() << "--backup-every 需要 1 到" << std::numeric_limits<int>::max() / (60 * 60 * 1000)
+                         << "之间的小时数:" << argv[i + 1];
+                return;
+            }
+            backup.setSchedule(QCoreApplication::applicationDirPath() + "/backups",
+                               int(intervalMs), 7, true);
+            qDebug() << "定时快照: 每" << hours << "小时";
+            return;
+        }
+    }
+}
+
+// 【新增】--import <目录>: 批量回填历史 (目录里是 WeatherManager 合并格式的 JSON，
+// 文件名以城市ID开头，例如 beijing.json、beijing-20260105.json)
+// 每批并行解析 (JsonHelper::parseWeatherBatch)，一个事务写库 (DBManager::saveParsedBatch)
+// 早于保留期的天会被丢弃 (那些年份只剩月度汇总)：单独计数，一天都没留下的文件算失败
+// 返回 0 = 全部成功，2 = 有文件失败或没有任何可写入的天，1 = 出错中止
+int importPayloads(const QString &dirPath)
+{
+    const int BATCH_SIZE = 500;
+
+    QDir dir(dirPath);
+    const QStringList files = dir.entryList({ "*.json" }, QDir::Files, QDir::Name);
+    if (files.isEmpty()) {
+        qDebug() << "没有可导入的文件:" << dirPath;
+        return 1;
+    }
+
+    DBManager &db = DBManager::getInstance();
+    const int oldestYear = db.oldestKeptYear();
+
+    int imported = 0, failed = 0, empty = 0, written = 0;
+    quint64 expired = 0;
+    for (int start = 0; start < files.size(); start += BATCH_SIZE) {
+        QList<RawPayload> payloads;
+        QStringList names;   // 与 payloads 一一对应
+        for (int i = start; i < qMin(files.size(), start + BATCH_SIZE); ++i) {
+            QFile file(dir.filePath(files[i]));
+            if (!file.open(QFile::ReadOnly)) {
+                qDebug() << "无法读取:" << files[i];
+                ++failed;
+                continue;
+            }
+            // 城市ID = 文件名里第一个 '-' 或 '.' 之前的部分
+            QString cityId = files[i].section('.', 0, 0).section('-', 0, 0).toLower();
+            payloads.append({ cityId, file.readAll() });
+            names.append(files[i]);
+        }
+
+        ParsedBatch batch = JsonHelper::parseWeatherBatch(payloads);
+        const quint64 expiredBefore = db.historyWriteStats().skippedExpired;
+        int rows = db.saveParsedBatch(batch);
+        if (rows < 0) {
+            qDebug() << "导入失败，已回滚本批:" << start << "起";
+            return 1;
+        }
+        written += rows;
+        expired += db.historyWriteStats().skippedExpired - expiredBefore;
+
+        for (int c = 0; c < batch.ok.size(); ++c) {
+            if (!batch.ok[c]) {
+                qDebug() << "解析失败:" << names[c];
+                ++failed;
+                continue;
+            }
+            // 保留期内的天数 (其余的被丢弃)
+            int kept = 0;
+            for (int d = batch.dayOffsets[c]; d < batch.dayOffsets[c + 1]; ++d) {
+                if (QDate::fromJulianDay(batch.days[d].julianDay).year() >= oldestYear) ++kept;
+            }
+            if (kept == 0) {
+                qDebug() << "没有可写入的天 (为空或全部早于" << oldestYear << "年):" << names[c];
+                ++empty;
+            } else {
+                ++imported;
+            }
+        }
+        qDebug() << "已导入" << qMin(files.size(), start + BATCH_SIZE) << "/" << files.size();
+    }
+
+    qDebug() << "导入完成: 成功" << imported << "个文件, 失败" << failed << ", 无可写入数据" << empty
+             << ", 写入" << written << "行历史, 超过保留期丢弃" << expired << "行";
+    return (failed > 0 || empty > 0) ? 2 : 0;
+}
+
+} // namespace
 
 int main(int argc, char *argv[])
 {
+    // 【新增】服务模式: WeatherAnalysis --serve [端口]
+    // 不创建任何窗口，只在本机提供只读查询接口，多个客户端共用同一份数据库和缓存
+    for (int i = 1; i < argc; ++i) {
+        // 【新增】一次性在线备份: WeatherAnalysis --backup <文件> (以 .qz 结尾时写压缩快照)
+        // 可以在界面/服务正在运行、正在写库的时候执行，拿到的是一致的快照
+        // 不调用 initDB()：备份只需要一个只读连接，不能在别的进程正在写的库上建表/改 PRAGMA
+        if (QByteArray(argv[i]) == "--backup" && i + 1 < argc) {
+            QCoreApplication app(argc, argv);
+            const QString dbPath = DBManager::databasePath();
+            if (!QFileInfo::exists(dbPath)) {
+                qDebug() << "数据库不存在:" << dbPath;
+                return 1;
+            }
+            DBReadPool::getInstance().setDatabasePath(dbPath);
+
+            const QString path = QDir::fromNativeSeparators(QString::fromLocal8Bit(argv[i + 1]));
+            DBBackup backup;
+            QObject::connect(&backup, &DBBackup::finished, &app, [&app](bool ok) {
+                app.exit(ok ? 0 : 1);
+            });
+            if (!backup.start(path, path.endsWith(".qz"))) return 1;
+            return app.exec();
+        }
+
+        // 【新增】老库切换到增量 VACUUM (整库重写一次，只需要做一次，程序不要同时运行)
+        if (QByteArray(argv[i]) == "--convert-vacuum") {
+            QCoreApplication app(argc, argv);
+            if (!DBManager::getInstance().initDB()) return 1;
+            return DBManager::getInstance().convertToIncrementalVacuum() ? 0 : 1;
+        }
+
+        // 【新增】批量回填: WeatherAnalysis --import <目录>
+        if (QByteArray(argv[i]) == "--import" && i + 1 < argc) {
+            QCoreApplication app(argc, argv);
+            if (!DBManager::getInstance().initDB()) return 1;
+            return importPayloads(QString::fromLocal8Bit(argv[i + 1]));
+        }
+
+        // 【新增】导出列式历史文件: WeatherAnalysis --export-columnar <文件.whc>
+        if (QByteArray(argv[i]) == "--export-columnar" && i + 1 < argc) {
+            QCoreApplication app(argc, argv);
+            if (!DBManager::getInstance().initDB()) return 1;
+            return ColumnarHistoryWriter::exportHistory(QString::fromLocal8Bit(argv[i + 1])) ? 0 : 1;
+        }
+
+        // 【新增】批量导出气温图: WeatherAnalysis --export-charts <目录> [城市1,城市2,...] [--svg] [--from <文件.whc>]
+        // 不打开窗口；不指定城市时导出所有有历史数据的城市，目录里同时生成 index.csv
+        // --from 时直接从列式文件画图，不查数据库 (城市默认取文件里的全部城市)
+        if (QByteArray(argv[i]) == "--export-charts" && i + 1 < argc) {
+            // 离屏导出只用 QPainter 画到 QImage/SVG 上，不用 QChart 和控件；
+            // 画字要用字体数据库，所以要 QGuiApplication，不需要 QApplication
+            QGuiApplication app(argc, argv);
+
+            QStringList cityIds;
+            QString columnarPath;
+            bool svg = false;
+            for (int j = i + 2; j < argc; ++j) {
+                const QByteArray arg(argv[j]);
+                if (arg == "--svg") svg = true;
+                else if (arg == "--from" && j + 1 < argc) columnarPath = QString::fromLocal8Bit(argv[++j]);
+                else if (!arg.startsWith("--")) cityIds = QString::fromLocal8Bit(arg).split(',', Qt::SkipEmptyParts);
+            }
+            // --from 时完全不碰数据库 (不建表、不改 PRAGMA)，列式文件可以拿到没有数据库的机器上用
+            if (columnarPath.isEmpty() && !DBManager::getInstance().initDB()) return 1;
+            if (cityIds.isEmpty()) {
+                if (columnarPath.isEmpty()) {
+                    cityIds = DBManager::getInstance().citiesWithHistory();
+                } else {
+                    ColumnarHistoryReader reader;
+                    if (reader.open(columnarPath)) cityIds = reader.cityIds();
+                }
+            }
+
+            ChartExportJob job;
+            job.setColumnarSource(columnarPath);
+            job.setOutputDir(QString::fromLocal8Bit(argv[i + 1]));
+            job.setFormat(svg ? ChartExportJob::Svg : ChartExportJob::Png);
+            QObject::connect(&job, &ChartExportJob::progress, [](int done, int total) {
+                qDebug() << "导出进度:" << done << "/" << total;
+            });
+            QObject::connect(&job, &ChartExportJob::finished, &app, [&app, &cityIds](int succeeded) {
+                app.exit(succeeded == cityIds.size() ? 0 : 2);
+            });
+            if (!job.start(cityIds)) return 1;
+            return app.exec();
+        }
+
+        // 【新增】还原压缩快照: WeatherAnalysis --restore-snapshot <快照.qz> <输出.db>
+        if (QByteArray(argv[i]) == "--restore-snapshot" && i + 2 < argc) {
+            return DBBackup::restoreSnapshot(QString::fromLocal8Bit(argv[i + 1]),
+                                             QString::fromLocal8Bit(argv[i + 2])) ? 0 : 1;
+        }
+
+        if (QByteArray(argv[i]) == "--serve") {
+            QCoreApplication app(argc, argv);
+            quint16 port = 8765;
+            if (i + 1 < argc) {
+                bool ok = false;
+                int value = QByteArray(argv[i + 1]).toInt(&ok);
+                if (ok && value > 0 && value < 65536) port = quint16(value);
+            }
+
+            if (!DBManager::getInstance().initDB()) return 1;
+
+            WeatherService service;
+            if (!service.listen(port)) return 1;
+
+            DBBackup backup;
+            startScheduledBackup(backup, argc, argv);
+            return app.exec();
+        }
+    }
+
     QApplication a(argc, argv);
 
     MainWindow w;
     w.show();
 
+    DBBackup backup;
+    startScheduledBackup(backup, argc, argv);
+
     return a.exec();
 }
@@ -0,0 +1,101 @@
+#include "cityindex.h"
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+#include <algorithm>
+
+bool CityIndex::load(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        qDebug() << "城市字典加载失败:" << filePath;
+        return false;
+    }
+
+    m_cities.clear();
+    m_keys.clear();
+
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) continue;
+
+        QStringList parts = line.split(',');
+        if (parts.size() < 2) continue;
+
+        CityInfo city;
+        city.pinyin = parts[0].trimmed().toLower();
+        city.name = parts[1].trimmed();
+        if (parts.size() > 2) city.seniverseId = parts[2].trimmed();
+        if (parts.size() > 4) {
+            bool okLat = false, okLon = false;
+            double lat = parts[3].trimmed().toDouble(&okLat);
+            double lon = parts[4].trimmed().toDouble(&okLon);
+            if (okLat && okLon) {
+                city.lat = lat;
+                city.lon = lon;
+            }
+        }
+        if (city.pinyin.isEmpty()) continue;
+
+        int index = m_cities.size();
+        m_cities.append(city);
+
+        m_keys.append({ city.pinyin, index });
+        if (!city.name.isEmpty()) m_keys.append({ city.name, index });
+        if (!city.seniverseId.isEmpty()) m_keys.append({ city.seniverseId.toLower(), index });
+    }
+
+    std::sort(m_keys.begin(), m_keys.end(), [](const Key &a, const Key &b) {
+        return a.key < b.key;
+    });
+
+    qDebug() << "城市字典已加载:" << m_cities.size() << "个城市";
+    return true;
+}
+
+int CityIndex::lowerBound(const QString &key) const
+{
+    auto it = std::lower_bound(m_keys.constBegin(), m_keys.constEnd(), key,
+                               [](const Key &k, const QString &value) { return k.key < value; });
+    return int(it - m_keys.constBegin());
+}
+
+QVector<int> CityIndex::match(const QString &prefix, int limit) const
+{
+    QVector<int> result;
+    const QString p = prefix.trimmed().toLower();
+    if (p.isEmpty()) return result;
+
+    for (int i = lowerBound(p); i < m_keys.size() && result.size() < limit; ++i) {
+        if (!m_keys[i].key.startsWith(p)) break;
+        // 同一个城市可能通过拼音和 ID 都命中，去重
+        if (!result.contains(m_keys[i].city)) result.append(m_keys[i].city);
+    }
+    return result;
+}
+
+const CityInfo *CityIndex::find(const QString &key) const
+{
+    const QString k = key.trimmed().toLower();
+    int i = lowerBound(k);
+    if (i < m_keys.size() && m_keys[i].key == k) {
+        return &m_cities[m_keys[i].city];
+    }
+    return nullptr;
+}
+
+QList<CityLocation> CityIndex::locations() const
+{
+    QList<CityLocation> list;
+    list.reserve(m_cities.size());
+    for (const CityInfo &city : m_cities) {
+        CityLocation loc;
+        loc.cityId = city.pinyin;
+        loc.name = city.name;
+        loc.lat = city.lat;
+        loc.lon = city.lon;
+        list.append(loc);
+    }
+    return list;
+}
@@ -0,0 +1,56 @@
+#ifndef CITYINDEX_H
+#define CITYINDEX_H
+
+#include <QString>
+#include <QVector>
+#include <QtNumeric>
+#include "weatherdata.h"
+
+/**
+ * @brief 城市字典条目
+ */
+struct CityInfo {
+    QString pinyin;     // 拼音 (例如 "beijing")，也是查询接口、缓存表使用的 city_id
+    QString name;       // 中文名 (例如 "北京")
+    QString seniverseId; // 心知天气 ID，可能为空
+    double lat = qQNaN(); // 【新增】纬度 / 经度，字典里没填时为 NaN
+    double lon = qQNaN();
+};
+
+/**
+ * @brief 城市前缀索引
+ * 启动时把资源里的城市字典读进内存，拼音/中文名/ID 都作为键放进一个排好序的数组，
+ * 前缀查询 = 一次二分查找 + 顺序扫描，用于输入框的实时补全。
+ */
+class CityIndex
+{
+public:
+    // 加载 CSV 字典 (拼音,中文名,心知ID,纬度,经度)，以 # 开头的行是注释
+    bool load(const QString &filePath);
+
+    // 前缀匹配 (不区分大小写)，返回城市在字典中的下标，最多 limit 个，按键的字典序
+    QVector<int> match(const QString &prefix, int limit = 10) const;
+
+    // 精确查找拼音或心知ID，找不到返回 nullptr
+    const CityInfo *find(const QString &key) const;
+
+    const CityInfo &at(int index) const { return m_cities[index]; }
+
+    // 【新增】字典里的坐标，转成 CityLocation (没有行政区划)，给 DBManager::saveCityLocations 用
+    QList<CityLocation> locations() const;
+    int size() const { return m_cities.size(); }
+
+private:
+    struct Key {
+        QString key;    // 已转小写
+        int city;       // m_cities 下标
+    };
+
+    // 返回第一个 >= key 的位置
+    int lowerBound(const QString &key) const;
+
+    QVector<CityInfo> m_cities;
+    QVector<Key> m_keys;  // 按 key 升序
+};
+
+#endif // CITYINDEX_H
@@ -0,0 +1,173 @@
+#include "cityspatialindex.h"
+#include <QtMath>
+#include <algorithm>
+
+namespace {
+const double EARTH_RADIUS_KM = 6371.0;
+const double KM_PER_DEGREE = 111.19;   // 1° 纬度对应的弧长
+}
+
+CitySpatialIndex::CitySpatialIndex(double cellDegrees)
+    : m_cellDegrees(cellDegrees > 0 ? cellDegrees : 1.0)
+{
+}
+
+void CitySpatialIndex::clear()
+{
+    m_locations.clear();
+    m_byId.clear();
+    m_cells.clear();
+    m_regions.clear();
+    m_minRow = m_minCol = 0;
+    m_maxRow = m_maxCol = -1;
+}
+
+int CitySpatialIndex::rowOf(double lat) const
+{
+    return int(qFloor(lat / m_cellDegrees));
+}
+
+int CitySpatialIndex::colOf(double lon) const
+{
+    return int(qFloor(lon / m_cellDegrees));
+}
+
+void CitySpatialIndex::insert(const CityLocation &location)
+{
+    if (location.cityId.isEmpty()) return;
+
+    int index;
+    auto it = m_byId.constFind(location.cityId);
+    if (it != m_byId.constEnd()) {
+        // 位置或区划可能变了，先从旧的格子/区域里摘掉
+        index = it.value();
+        removeFromIndex(index);
+        m_locations[index] = location;
+    } else {
+        index = m_locations.size();
+        m_locations.append(location);
+        m_byId.insert(location.cityId, index);
+    }
+
+    if (location.hasCoordinates()) {
+        int row = rowOf(location.lat);
+        int col = colOf(location.lon);
+        m_cells[cellKey(row, col)].append(index);
+
+        if (m_maxRow < m_minRow) {
+            m_minRow = m_maxRow = row;
+            m_minCol = m_maxCol = col;
+        } else {
+            m_minRow = qMin(m_minRow, row);
+            m_maxRow = qMax(m_maxRow, row);
+            m_minCol = qMin(m_minCol, col);
+            m_maxCol = qMax(m_maxCol, col);
+        }
+    }
+
+    for (const QString &region : regionsOf(location.path)) {
+        m_regions[region].append(location.cityId);
+    }
+}
+
+void CitySpatialIndex::removeFromIndex(int index)
+{
+    const CityLocation &old = m_locations[index];
+
+    if (old.hasCoordinates()) {
+        auto cell = m_cells.find(cellKey(rowOf(old.lat), colOf(old.lon)));
+        if (cell != m_cells.end()) {
+            cell->removeAll(index);
+            if (cell->isEmpty()) m_cells.erase(cell);
+        }
+        // 格子范围只会变大不会缩小，多扩几圈空格子不影响结果
+    }
+
+    for (const QString &region : regionsOf(old.path)) {
+        auto list = m_regions.find(region);
+        if (list == m_regions.end()) continue;
+        list->removeAll(old.cityId);
+        if (list->isEmpty()) m_regions.erase(list);
+    }
+}
+
+const CityLocation *CitySpatialIndex::find(const QString &cityId) const
+{
+    auto it = m_byId.constFind(cityId);
+    return it == m_byId.constEnd() ? nullptr : &m_locations[it.value()];
+}
+
+QVector<CityDistance> CitySpatialIndex::nearest(double lat, double lon, int n,
+                                                const std::function<bool(const QString &)> &filter) const
+{
+    QVector<CityDistance> result;
+    if (n <= 0 || qIsNaN(lat) || qIsNaN(lon) || m_maxRow < m_minRow) return result;
+
+    const int row0 = rowOf(lat);
+    const int col0 = colOf(lon);
+    // 扩到这一圈就覆盖了所有有城市的格子
+    const int maxRing = qMax(qMax(qAbs(row0 - m_minRow), qAbs(row0 - m_maxRow)),
+                             qMax(qAbs(col0 - m_minCol), qAbs(col0 - m_maxCol)));
+
+    auto byDistance = [](const CityDistance &a, const CityDistance &b) { return a.km < b.km; };
+
+    for (int ring = 0; ring <= maxRing; ++ring) {
+        // 只访问第 ring 圈边上的格子 (内圈已经看过)
+        for (int row = row0 - ring; row <= row0 + ring; ++row) {
+            const bool edgeRow = (row == row0 - ring || row == row0 + ring);
+            const int step = edgeRow ? 1 : 2 * ring;
+            for (int col = col0 - ring; col <= col0 + ring; col += qMax(step, 1)) {
+                auto cell = m_cells.constFind(cellKey(row, col));
+                if (cell == m_cells.constEnd()) continue;
+
+                for (int index : cell.value()) {
+                    const CityLocation &loc = m_locations[index];
+                    if (filter && !filter(loc.cityId)) continue;
+                    result.append({ loc.cityId, distanceKm(lat, lon, loc.lat, loc.lon) });
+                }
+            }
+        }
+
+        if (result.size() < n) continue;
+
+        // 第 ring 圈以外的城市离查询点至少 ring 个格子：纬向 ring*cell 度，
+        // 经向按这片区域里最靠近极地的纬度折算 (保守估计)
+        std::sort(result.begin(), result.end(), byDistance);
+        const double edgeLat = qMin(89.0, qAbs(lat) + (ring + 1) * m_cellDegrees);
+        const double outsideKm = ring * m_cellDegrees * KM_PER_DEGREE * qCos(qDegreesToRadians(edgeLat));
+        if (result[n - 1].km <= outsideKm) break;
+    }
+
+    std::sort(result.begin(), result.end(), byDistance);
+    if (result.size() > n) result.resize(n);
+    return result;
+}
+
+QStringList CitySpatialIndex::citiesInRegion(const QString &region) const
+{
+    return m_regions.value(region);
+}
+
+QStringList CitySpatialIndex::regionsOf(const QString &path)
+{
+    QStringList parts = path.split(',', Qt::SkipEmptyParts);
+    for (QString &p : parts) p = p.trimmed();
+
+    QStringList regions;
+    // 直辖市的路径是 "北京,北京,中国"，上级区域同样是 "北京,中国" 和 "中国"
+    for (int i = 1; i < parts.size(); ++i) {
+        regions.append(parts.mid(i).join(','));
+    }
+    return regions;
+}
+
+double CitySpatialIndex::distanceKm(double lat1, double lon1, double lat2, double lon2)
+{
+    // Haversine 公式
+    const double dLat = qDegreesToRadians(lat2 - lat1);
+    const double dLon = qDegreesToRadians(lon2 - lon1);
+    const double a = qSin(dLat / 2) * qSin(dLat / 2)
+                     + qCos(qDegreesToRadians(lat1)) * qCos(qDegreesToRadians(lat2))
+                       * qSin(dLon / 2) * qSin(dLon / 2);
+    return 2 * EARTH_RADIUS_KM * qAsin(qSqrt(qMin(1.0, a)));
+}
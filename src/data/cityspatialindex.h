@@ -0,0 +1,62 @@
+#ifndef CITYSPATIALINDEX_H
+#define CITYSPATIALINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <functional>
+#include "weatherdata.h"
+
+/**
+ * @brief 城市位置的内存索引
+ * 坐标按经纬度网格分桶 (默认 1°×1°)，就近查询从所在格子一圈圈向外扩，
+ * 找够 N 个并且下一圈不可能更近时停止，不用遍历全部城市；
+ * 行政区划按路径后缀建倒排表，"某省有哪些城市" 直接查哈希表。
+ * 经度不做 180° 回绕处理 (城市都在国内)。
+ */
+class CitySpatialIndex
+{
+public:
+    explicit CitySpatialIndex(double cellDegrees = 1.0);
+
+    void clear();
+
+    // 插入或替换 (按 cityId)
+    void insert(const CityLocation &location);
+
+    // 找不到返回 nullptr
+    const CityLocation *find(const QString &cityId) const;
+    int size() const { return m_locations.size(); }
+
+    // 离 (lat, lon) 最近的 n 个城市 (按距离升序)，filter 返回 false 的城市跳过
+    QVector<CityDistance> nearest(double lat, double lon, int n,
+                                  const std::function<bool(const QString &)> &filter = {}) const;
+
+    // 区域内的城市ID，region 是路径后缀，例如 "广东,中国"
+    QStringList citiesInRegion(const QString &region) const;
+
+    // 路径的所有上级区域 (去掉第一级后的各个后缀)，"海淀,北京,中国" -> ["北京,中国", "中国"]
+    static QStringList regionsOf(const QString &path);
+
+    // 两点间球面距离 (公里)
+    static double distanceKm(double lat1, double lon1, double lat2, double lon2);
+
+private:
+    qint64 cellKey(int row, int col) const { return (qint64(row) << 32) | quint32(col); }
+    int rowOf(double lat) const;
+    int colOf(double lon) const;
+    void removeFromIndex(int index);
+
+    double m_cellDegrees;
+
+    QVector<CityLocation> m_locations;
+    QHash<QString, int> m_byId;                 // cityId -> m_locations 下标
+    QHash<qint64, QVector<int>> m_cells;        // 网格 -> 城市下标
+    QHash<QString, QStringList> m_regions;      // 区域 -> 城市ID
+
+    // 有城市的格子的范围，扩圈时超过这个范围就可以停了
+    int m_minRow = 0, m_maxRow = -1, m_minCol = 0, m_maxCol = -1;
+};
+
+#endif // CITYSPATIALINDEX_H
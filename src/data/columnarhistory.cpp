@@ -0,0 +1,287 @@
+#include "columnarhistory.h"
+#include "dbmanager.h"
+#include <QSaveFile>
+#include <QtEndian>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+const char MAGIC[8] = { 'W', 'H', 'C', 'O', 'L', '1', '\0', '\0' };
+const quint32 FORMAT_VERSION = 1;
+const int HEADER_SIZE = 32;
+const int CITY_ENTRY_SIZE = 16;
+
+template <typename T>
+void appendLE(QByteArray &buf, T value)
+{
+    T le = qToLittleEndian(value);
+    buf.append(reinterpret_cast<const char *>(&le), sizeof(T));
+}
+
+} // namespace
+
+// ======================= 导出 =======================
+
+bool ColumnarHistoryWriter::exportHistory(const QString &filePath)
+{
+    QSqlDatabase db = DBManager::getInstance().getDatabase();
+    if (!db.isOpen()) return false;
+
+    // 1. 顺序扫一遍全表，按 城市 + 日期 排好，每个城市天然是连续一段
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT city_id, date, high, low FROM WeatherHistory ORDER BY city_id, date")) {
+        qDebug() << "导出历史失败:" << query.lastError();
+        return false;
+    }
+
+    QByteArray strings;
+    QByteArray directory;
+    QVector<qint32> dates;
+    QVector<qint16> highs;
+    QVector<qint16> lows;
+
+    QString currentCity;
+    quint32 cityFirstRow = 0;
+    quint32 cityCount = 0;
+    quint32 idOffset = 0;
+    quint32 idLength = 0;
+
+    auto flushCity = [&]() {
+        if (currentCity.isEmpty()) return;
+        appendLE<quint32>(directory, idOffset);
+        appendLE<quint32>(directory, idLength);
+        appendLE<quint32>(directory, cityFirstRow);
+        appendLE<quint32>(directory, quint32(dates.size()) - cityFirstRow);
+        ++cityCount;
+    };
+
+    while (query.next()) {
+        QString cityId = query.value(0).toString();
+        if (cityId != currentCity) {
+            flushCity();
+            currentCity = cityId;
+            cityFirstRow = quint32(dates.size());
+
+            QByteArray idBytes = cityId.toUtf8();
+            idOffset = quint32(strings.size());
+            idLength = quint32(idBytes.size());
+            strings.append(idBytes);
+        }
+
+        QDate date = QDate::fromString(query.value(1).toString(), "yyyy-MM-dd");
+        dates.append(qint32(date.toJulianDay()));
+        highs.append(qint16(query.value(2).toInt()));
+        lows.append(qint16(query.value(3).toInt()));
+    }
+    flushCity();
+
+    // 字符串区补齐到 4 字节，保证后面的 int32 列对齐
+    while (strings.size() % 4 != 0) strings.append('\0');
+
+    // 2. 拼文件
+    QByteArray header;
+    header.append(MAGIC, sizeof(MAGIC));
+    appendLE<quint32>(header, FORMAT_VERSION);
+    appendLE<quint32>(header, cityCount);
+    appendLE<quint32>(header, quint32(dates.size()));
+    appendLE<quint32>(header, quint32(strings.size()));
+    appendLE<quint32>(header, 0);
+    appendLE<quint32>(header, 0);
+
+    QByteArray columns;
+    columns.reserve(dates.size() * 8);
+    for (qint32 d : dates) appendLE<qint32>(columns, d);
+    for (qint16 h : highs) appendLE<qint16>(columns, h);
+    for (qint16 l : lows) appendLE<qint16>(columns, l);
+
+    // QSaveFile: 写完再原子替换，读者不会看到写了一半的文件
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "无法创建导出文件:" << filePath;
+        return false;
+    }
+    file.write(header);
+    file.write(directory);
+    file.write(strings);
+    file.write(columns);
+    if (!file.commit()) {
+        qDebug() << "导出文件写入失败:" << filePath;
+        return false;
+    }
+
+    qDebug() << "列式导出完成:" << filePath << "城市数:" << cityCount << "行数:" << dates.size();
+    return true;
+}
+
+// ======================= 读取 (mmap) =======================
+
+ColumnarHistoryReader::ColumnarHistoryReader() {}
+
+ColumnarHistoryReader::~ColumnarHistoryReader()
+{
+    close();
+}
+
+bool ColumnarHistoryReader::open(const QString &filePath)
+{
+    close();
+
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    // 文件是小端序，大端机器上不能直接把映射内存当数组用
+    qDebug() << "列式文件只支持小端序机器";
+    return false;
+#endif
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qDebug() << "无法打开列式文件:" << filePath;
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    if (size < HEADER_SIZE) {
+        m_file.close();
+        return false;
+    }
+
+    uchar *base = m_file.map(0, size);
+    if (!base) {
+        qDebug() << "mmap 失败:" << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    // 校验头部
+    quint32 version = 0, stringsSize = 0;
+    std::memcpy(&version, base + 8, 4);
+    std::memcpy(&m_cityCount, base + 12, 4);
+    std::memcpy(&m_rowCount, base + 16, 4);
+    std::memcpy(&stringsSize, base + 20, 4);
+
+    const qint64 dirOffset = HEADER_SIZE;
+    const qint64 strOffset = dirOffset + qint64(m_cityCount) * CITY_ENTRY_SIZE;
+    const qint64 dateOffset = strOffset + stringsSize;
+    const qint64 highOffset = dateOffset + qint64(m_rowCount) * 4;
+    const qint64 lowOffset = highOffset + qint64(m_rowCount) * 2;
+    const qint64 endOffset = lowOffset + qint64(m_rowCount) * 2;
+
+    if (std::memcmp(base, MAGIC, sizeof(MAGIC)) != 0 || version != FORMAT_VERSION
+        || stringsSize % 4 != 0 || endOffset > size) {
+        qDebug() << "列式文件格式不正确:" << filePath;
+        m_file.unmap(base);
+        m_file.close();
+        m_cityCount = m_rowCount = 0;
+        return false;
+    }
+
+    // 校验每个目录项：城市ID 要落在字符串区内，行范围要落在列内，
+    // 否则截断或损坏的文件会让 cityIdAt()/columns() 读到映射区域外面
+    for (quint32 i = 0; i < m_cityCount; ++i) {
+        CityEntry e;
+        std::memcpy(&e, base + dirOffset + qint64(i) * CITY_ENTRY_SIZE, sizeof(e));
+        if (quint64(e.idOffset) + e.idLength > stringsSize
+            || quint64(e.firstRow) + e.rowCount > m_rowCount) {
+            qDebug() << "列式文件目录项越界:" << filePath << "第" << i << "项";
+            m_file.unmap(base);
+            m_file.close();
+            m_cityCount = m_rowCount = 0;
+            return false;
+        }
+    }
+
+    m_base = base;
+    m_cities = reinterpret_cast<const CityEntry *>(base + dirOffset);
+    m_strings = reinterpret_cast<const char *>(base + strOffset);
+    m_dates = reinterpret_cast<const qint32 *>(base + dateOffset);
+    m_high = reinterpret_cast<const qint16 *>(base + highOffset);
+    m_low = reinterpret_cast<const qint16 *>(base + lowOffset);
+    return true;
+}
+
+void ColumnarHistoryReader::close()
+{
+    if (m_base) {
+        m_file.unmap(m_base);
+        m_base = nullptr;
+    }
+    if (m_file.isOpen()) m_file.close();
+
+    m_cityCount = m_rowCount = 0;
+    m_cities = nullptr;
+    m_strings = nullptr;
+    m_dates = nullptr;
+    m_high = m_low = nullptr;
+}
+
+QStringList ColumnarHistoryReader::cityIds() const
+{
+    QStringList ids;
+    for (quint32 i = 0; i < m_cityCount; ++i) {
+        ids << QString::fromUtf8(cityIdAt(int(i)));
+    }
+    return ids;
+}
+
+int ColumnarHistoryReader::rowCount() const
+{
+    return int(m_rowCount);
+}
+
+QByteArray ColumnarHistoryReader::cityIdAt(int index) const
+{
+    const CityEntry &e = m_cities[index];
+    // fromRawData 不拷贝，只包一层
+    return QByteArray::fromRawData(m_strings + e.idOffset, int(e.idLength));
+}
+
+int ColumnarHistoryReader::findCity(const QByteArray &cityId) const
+{
+    // 目录按 city_id 升序 (与导出时 ORDER BY city_id 一致)，二分查找
+    int lo = 0, hi = int(m_cityCount) - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = cityIdAt(mid).compare(cityId);
+        if (cmp == 0) return mid;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+HistoryColumns ColumnarHistoryReader::columns(const QString &cityId) const
+{
+    HistoryColumns cols;
+    if (!m_base) return cols;
+
+    int index = findCity(cityId.toUtf8());
+    if (index < 0) return cols;
+
+    const CityEntry &e = m_cities[index];
+    cols.julianDays = m_dates + e.firstRow;
+    cols.high = m_high + e.firstRow;
+    cols.low = m_low + e.firstRow;
+    cols.count = int(e.rowCount);
+    return cols;
+}
+
+QList<DayWeather> ColumnarHistoryReader::historyData(const QString &cityId) const
+{
+    return toDayWeather(columns(cityId));
+}
+
+QList<DayWeather> ColumnarHistoryReader::toDayWeather(const HistoryColumns &cols)
+{
+    QList<DayWeather> list;
+    list.reserve(cols.count);
+
+    for (int i = 0; i < cols.count; ++i) {
+        DayWeather day;
+        day.date = QDate::fromJulianDay(cols.julianDays[i]).toString("yyyy-MM-dd");
+        day.high = cols.high[i];
+        day.low = cols.low[i];
+        list.append(day);
+    }
+    return list;
+}
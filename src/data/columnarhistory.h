@@ -0,0 +1,96 @@
+#ifndef COLUMNARHISTORY_H
+#define COLUMNARHISTORY_H
+
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QVector>
+#include "weatherdata.h"
+
+/**
+ * 列式历史文件格式 (.whc)，小端序，所有数值按自然边界对齐，可以直接 mmap 后当数组用：
+ *
+ *   [Header 32 字节]
+ *     char    magic[8]      "WHCOL1\0\0"
+ *     uint32  version       = 1
+ *     uint32  cityCount
+ *     uint32  rowCount
+ *     uint32  stringsSize   城市ID字符串区大小 (已补齐到 4 的倍数)
+ *     uint32  reserved[2]
+ *   [城市目录 cityCount × 16 字节，按 city_id 升序]
+ *     uint32  idOffset      在字符串区中的偏移
+ *     uint32  idLength      UTF-8 字节数
+ *     uint32  firstRow      该城市第一行在各列中的下标
+ *     uint32  rowCount      该城市的行数
+ *   [字符串区 stringsSize 字节]
+ *   [date 列  rowCount × int32]  儒略日 (QDate::toJulianDay)，每个城市内部按日期升序
+ *   [high 列  rowCount × int16]
+ *   [low  列  rowCount × int16]
+ *
+ * 同一城市的数据在每一列里都是连续的一段，读某个城市 = 三个指针 + 长度，不需要拷贝。
+ * (仓库没有 Parquet 依赖，所以用这个自定义格式)
+ *
+ * 只包含保留期内的逐日数据 (WeatherHistory 视图)；已压缩成月度汇总的年份
+ * 仍在 WeatherHistoryMonthly 里 (DBManager::getMonthlyHistory)，不在这个文件中。
+ * 用法：--export-columnar 导出，--export-charts ... --from <文件> 直接从文件画图，不查数据库。
+ */
+
+// 单个城市的列视图，指针直接指向映射内存，文件关闭后失效
+struct HistoryColumns {
+    const qint32 *julianDays = nullptr;
+    const qint16 *high = nullptr;
+    const qint16 *low = nullptr;
+    int count = 0;
+};
+
+class ColumnarHistoryWriter
+{
+public:
+    // 把 WeatherHistory 整表导出为列式文件，返回 false 表示失败
+    static bool exportHistory(const QString &filePath);
+};
+
+class ColumnarHistoryReader
+{
+public:
+    ColumnarHistoryReader();
+    ~ColumnarHistoryReader();
+
+    // 映射文件并校验头部
+    bool open(const QString &filePath);
+    void close();
+    bool isOpen() const { return m_base != nullptr; }
+
+    QStringList cityIds() const;
+    int rowCount() const;
+
+    // 零拷贝：返回该城市的列指针 (找不到时 count = 0)
+    HistoryColumns columns(const QString &cityId) const;
+
+    // 转成图表使用的结构体 (这一步才会分配内存)
+    QList<DayWeather> historyData(const QString &cityId) const;
+    static QList<DayWeather> toDayWeather(const HistoryColumns &cols);
+
+private:
+    struct CityEntry {
+        quint32 idOffset;
+        quint32 idLength;
+        quint32 firstRow;
+        quint32 rowCount;
+    };
+
+    QByteArray cityIdAt(int index) const;
+    int findCity(const QByteArray &cityId) const;
+
+    QFile m_file;
+    uchar *m_base = nullptr;
+    quint32 m_cityCount = 0;
+    quint32 m_rowCount = 0;
+    const CityEntry *m_cities = nullptr;
+    const char *m_strings = nullptr;
+    const qint32 *m_dates = nullptr;
+    const qint16 *m_high = nullptr;
+    const qint16 *m_low = nullptr;
+};
+
+#endif // COLUMNARHISTORY_H
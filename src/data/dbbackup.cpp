@@ -0,0 +1,200 @@
+#include "dbbackup.h"
+#include "dbreadpool.h"
+#include "dbmanager.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QDebug>
+
+namespace {
+const QByteArray SNAPSHOT_MAGIC = "WDBSNAP1";
+const QString SNAPSHOT_PREFIX = "weather-";
+}
+
+DBBackup::DBBackup(QObject *parent) : QObject(parent)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+DBBackup::~DBBackup()
+{
+    m_pool.waitForDone();
+}
+
+bool DBBackup::start(const QString &destPath, bool compress)
+{
+    if (m_running || destPath.isEmpty()) return false;
+    m_running = true;
+
+    m_pool.start([this, destPath, compress]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        // VACUUM INTO 要求目标文件不存在
+        const QString partPath = destPath + ".part";
+        QFile::remove(partPath);
+
+        QString error = snapshotInto(partPath);
+        if (error.isEmpty()) {
+            if (compress) {
+                error = compressFile(partPath, destPath);
+                QFile::remove(partPath);
+            } else {
+                QFile::remove(destPath);
+                if (!QFile::rename(partPath, destPath)) error = "rename failed: " + destPath;
+            }
+        } else {
+            QFile::remove(partPath);
+        }
+        qDebug() << "备份耗时:" << timer.elapsed() << "ms ->" << destPath;
+
+        QMetaObject::invokeMethod(this, [this, destPath, error]() {
+            onDone(destPath, error);
+        }, Qt::QueuedConnection);
+    });
+    return true;
+}
+
+QString DBBackup::snapshotInto(const QString &path)
+{
+    // 工作线程自己的只读连接：WAL 下读事务不挡主线程的写
+    QSqlDatabase db = DBReadPool::getInstance().connectionForCurrentThread();
+    if (!db.isOpen()) return "read connection not open";
+
+    QSqlQuery query(db);
+    // INTO 后面可以是任意字符串表达式，用绑定参数避免路径里的引号出问题
+    query.prepare("VACUUM INTO :path");
+    query.bindValue(":path", QDir::toNativeSeparators(path));
+    if (!query.exec()) return query.lastError().text();
+    return QString();
+}
+
+QString DBBackup::compressFile(const QString &srcPath, const QString &destPath)
+{
+    QFile src(srcPath);
+    if (!src.open(QFile::ReadOnly)) return "open failed: " + srcPath;
+
+    QSaveFile dest(destPath);
+    if (!dest.open(QFile::WriteOnly)) return "open failed: " + destPath;
+
+    QDataStream out(&dest);
+    out.setByteOrder(QDataStream::BigEndian);
+    out.writeRawData(SNAPSHOT_MAGIC.constData(), SNAPSHOT_MAGIC.size());
+
+    // 一块一块读、压、写，不会把整个库读进内存
+    while (!src.atEnd()) {
+        QByteArray chunk = src.read(CHUNK_BYTES);
+        if (chunk.isEmpty()) return "read failed: " + srcPath;
+
+        QByteArray packed = qCompress(chunk);
+        out << quint32(packed.size());
+        out.writeRawData(packed.constData(), packed.size());
+    }
+    out << quint32(0);
+
+    if (out.status() != QDataStream::Ok || !dest.commit()) return "write failed: " + destPath;
+    return QString();
+}
+
+bool DBBackup::restoreSnapshot(const QString &snapshotPath, const QString &dbPath)
+{
+    QFile src(snapshotPath);
+    if (!src.open(QFile::ReadOnly) || src.read(SNAPSHOT_MAGIC.size()) != SNAPSHOT_MAGIC) {
+        qDebug() << "不是有效的快照文件:" << snapshotPath;
+        return false;
+    }
+
+    QSaveFile dest(dbPath);
+    if (!dest.open(QFile::WriteOnly)) {
+        qDebug() << "无法写入:" << dbPath;
+        return false;
+    }
+
+    QDataStream in(&src);
+    in.setByteOrder(QDataStream::BigEndian);
+    while (true) {
+        quint32 size = 0;
+        in >> size;
+        if (in.status() != QDataStream::Ok) break;   // 没有结束标记 = 文件被截断
+        if (size == 0) return dest.commit();
+
+        QByteArray packed = src.read(size);
+        QByteArray chunk = qUncompress(packed);
+        if (packed.size() != int(size) || chunk.isEmpty() || dest.write(chunk) != chunk.size()) break;
+    }
+
+    qDebug() << "快照已损坏:" << snapshotPath;
+    dest.cancelWriting();
+    return false;
+}
+
+void DBBackup::onDone(const QString &path, const QString &error)
+{
+    m_running = false;
+
+    // 快照期间 WAL 检查点被卡住，积压了不少；读事务已经结束，马上写回
+    // (本进程没有打开写连接时，由写库的进程自己的检查点处理)
+    DBManager::getInstance().checkpointWal();
+
+    const bool ok = error.isEmpty();
+    const qint64 bytes = ok ? QFileInfo(path).size() : 0;
+    if (ok) qDebug() << "备份完成:" << path << bytes << "字节";
+    else qDebug() << "备份失败:" << path << error;
+
+    if (m_rotatePending) {
+        m_rotatePending = false;
+        if (ok) rotate();
+    }
+    emit finished(ok, path, bytes);
+}
+
+// ======================= 定时快照 =======================
+
+void DBBackup::setSchedule(const QString &dir, int intervalMs, int keep, bool compress)
+{
+    m_scheduleDir = dir;
+    m_keep = qMax(1, keep);
+    m_compress = compress;
+    QDir().mkpath(dir);
+
+    if (!m_scheduleTimer) {
+        m_scheduleTimer = new QTimer(this);
+        connect(m_scheduleTimer, &QTimer::timeout, this, &DBBackup::runScheduled);
+    }
+    m_scheduleTimer->start(intervalMs);
+}
+
+void DBBackup::stopSchedule()
+{
+    if (m_scheduleTimer) m_scheduleTimer->stop();
+}
+
+void DBBackup::runScheduled()
+{
+    // 上一份还没写完 (库很大) 就跳过这一次
+    if (m_running) return;
+
+    QString name = SNAPSHOT_PREFIX + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss")
+                   + (m_compress ? ".db.qz" : ".db");
+    if (start(QDir(m_scheduleDir).filePath(name), m_compress)) {
+        m_rotatePending = true;
+    }
+}
+
+void DBBackup::rotate()
+{
+    // 文件名里的时间戳按字典序就是时间顺序
+    QDir dir(m_scheduleDir);
+    QStringList files = dir.entryList({ SNAPSHOT_PREFIX + "*.db", SNAPSHOT_PREFIX + "*.db.qz" },
+                                      QDir::Files, QDir::Name);
+    while (files.size() > m_keep) {
+        const QString oldest = files.takeFirst();
+        if (dir.remove(oldest)) qDebug() << "删除旧快照:" << oldest;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef DBBACKUP_H
+#define DBBACKUP_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <QString>
+
+/**
+ * @brief 在线备份 / 定时快照
+ * 在后台线程用一个单独的只读连接 (见 DBReadPool) 执行 VACUUM INTO：数据库是 WAL 模式，
+ * 这个读事务看到的是开始那一刻的一致快照，期间主线程照常写入，不会被挡住，也不会拷出半截的文件。
+ * 先写到 "<目标>.part"，完成后再改名，目标文件要么是完整的旧备份，要么是完整的新备份。
+ *
+ * 代价：VACUUM INTO 是一个读事务，拷贝期间 WAL 的检查点推进不到这个快照之后，WAL 会持续变大
+ * (写入不受影响)。没有用 sqlite3_backup_step 分步拷贝：Qt 的 SQLite 驱动通常自带一份 SQLite，
+ * 把它的原生句柄交给另外链接的 libsqlite3 是未定义行为。作为补偿，主库设置了 journal_size_limit
+ * (DBManager::WAL_SIZE_LIMIT_BYTES)，备份结束后立即做一次检查点 (DBManager::checkpointWal)，
+ * WAL 在下一次重置时截回上限。
+ *
+ * 压缩快照 (.qz) 格式：
+ *   "WDBSNAP1" (8 字节)
+ *   若干块: quint32 压缩后长度 (大端) + qCompress(最多 4 MB 原始数据)
+ *   quint32 0 结束
+ * 按块压缩，内存占用和数据库大小无关；用 restoreSnapshot() 还原。
+ */
+class DBBackup : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DBBackup(QObject *parent = nullptr);
+    ~DBBackup();
+
+    // 备份到 destPath (异步)，compress 时写压缩快照；上一次还没完成时返回 false
+    bool start(const QString &destPath, bool compress = false);
+    bool isRunning() const { return m_running; }
+
+    // 定时快照：每 intervalMs 写一份到 dir (weather-yyyyMMdd-HHmmss.db[.qz])，只保留最新 keep 份
+    void setSchedule(const QString &dir, int intervalMs, int keep, bool compress = true);
+    void stopSchedule();
+
+    // 把压缩快照还原成普通的数据库文件
+    static bool restoreSnapshot(const QString &snapshotPath, const QString &dbPath);
+
+signals:
+    // 完成 (成功与否)，bytes 为最终文件大小
+    void finished(bool ok, const QString &path, qint64 bytes);
+
+private:
+    // 在当前 (工作) 线程执行，返回错误信息，成功返回空字符串
+    static QString snapshotInto(const QString &path);
+    static QString compressFile(const QString &srcPath, const QString &destPath);
+
+    void onDone(const QString &path, const QString &error);
+    void runScheduled();
+    void rotate();
+
+    QThreadPool m_pool;     // 只有一个线程，备份不会并发
+    bool m_running = false;
+
+    QTimer *m_scheduleTimer = nullptr;
+    QString m_scheduleDir;
+    int m_keep = 7;
+    bool m_compress = true;
+    bool m_rotatePending = false;   // 这次是定时快照，完成后要清理旧文件
+
+    static const int CHUNK_BYTES = 4 * 1024 * 1024;
+};
+
+#endif // DBBACKUP_H
@@ -1,4 +1,8 @@
 #include "dbmanager.h"
+#include "dbreadpool.h"
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <algorithm>
 
 DBManager::DBManager(QObject *parent) : QObject(parent)
 {
@@ -27,7 +31,7 @@ bool DBManager::initDB()
     // 1. 连接数据库
     m_db = QSqlDatabase::addDatabase("QSQLITE");
     // 数据库文件路径：在可执行文件同级目录下生成 weather.db
-    QString dbPath = QCoreApplication::applicationDirPath() + "/weather.db";
+    QString dbPath = databasePath();
     m_db.setDatabaseName(dbPath);
 
     if (!m_db.open()) {
@@ -35,9 +39,40 @@ bool DBManager::initDB()
         return false;
     }
 
+    // 【新增】开启增量 VACUUM，删除数据后可以分批回收空间，而不是整库重写
+    // auto_vacuum 模式只能在建表前设置，而且必须在切换 WAL 之前 (切换 WAL 会先写出文件头，
+    // 之后再设置会被 SQLite 静默忽略)：新库直接设置并读回确认；
+    // 老库需要完整 VACUUM 一次才能切换，这会重写整个文件，不能在界面线程里做，只提示
+    QSqlQuery query;
+    if (query.exec("PRAGMA auto_vacuum") && query.next() && query.value(0).toInt() != 2) {
+        query.finish();
+        if (query.exec("SELECT 1 FROM sqlite_master LIMIT 1") && !query.next()) {
+            query.finish();
+            query.exec("PRAGMA auto_vacuum = INCREMENTAL");
+            if (!query.exec("PRAGMA auto_vacuum") || !query.next() || query.value(0).toInt() != 2) {
+                qDebug() << "新库开启增量 VACUUM 失败:" << query.lastError();
+            }
+        } else {
+            qDebug() << "数据库未开启增量 VACUUM，维护时无法回收空间；"
+                        "请关闭程序后运行一次: WeatherAnalysis --convert-vacuum";
+        }
+    }
+    query.finish();
+
+    // 【新增】WAL 模式：读连接 (见 DBReadPool) 读的时候不会挡住写，写的时候也不会挡住读
+    QSqlQuery walQuery;
+    if (!walQuery.exec("PRAGMA journal_mode = WAL") || !walQuery.exec("PRAGMA synchronous = NORMAL")) {
+        qDebug() << "开启 WAL 失败:" << walQuery.lastError();
+    }
+    // 长时间的读事务 (比如在线备份) 期间检查点推进不了，WAL 会一直变大；
+    // 限制重置后保留的大小，读事务结束、检查点做完后文件会截回这个上限
+    if (!walQuery.exec(QString("PRAGMA journal_size_limit = %1").arg(WAL_SIZE_LIMIT_BYTES))) {
+        qDebug() << "设置 WAL 上限失败:" << walQuery.lastError();
+    }
+    walQuery.finish();
+
     // 2. 创建缓存表
     // 字段: 城市ID(主键), 城市名, JSON内容, 最后更新时间
-    QSqlQuery query;
     QString sql = "CREATE TABLE IF NOT EXISTS WeatherCache ("
                   "city_id TEXT PRIMARY KEY, "
                   "city_name TEXT, "
@@ -49,24 +84,182 @@ bool DBManager::initDB()
         return false;
     }
 
-    // 2. 【新增】创建历史数据表
-    // 关键点：PRIMARY KEY(city_id, date) —— 这就是联合主键！
-    QString sqlHistory = "CREATE TABLE IF NOT EXISTS WeatherHistory ("
+    // 3. 【修改】历史数据按年分表: WeatherHistory_2025, WeatherHistory_2026 ...
+    // 日期存成整数儒略日 (QDate::toJulianDay)，范围查询比较整数而不是字符串
+    // 旧版的单表 WeatherHistory (TEXT 日期) 会被迁移进分表，然后换成同名视图
+    if (!loadHistoryPartitions() || !migrateLegacyHistory()
+        || !ensureHistoryPartition(QDate::currentDate().year())) {
+        qDebug() << "创建历史表失败:" << m_db.lastError();
+        return false;
+    }
+
+    // 4. 【新增】月度汇总表：超过保留期的年份压缩到这里
+    QString sqlMonthly = "CREATE TABLE IF NOT EXISTS WeatherHistoryMonthly ("
+                         "city_id TEXT, "
+                         "month INTEGER, "      // yyyyMM，例如 202401
+                         "avg_high REAL, "
+                         "avg_low REAL, "
+                         "max_high INTEGER, "
+                         "min_low INTEGER, "
+                         "days INTEGER, "
+                         "PRIMARY KEY(city_id, month)) WITHOUT ROWID";
+
+    if (!query.exec(sqlMonthly)) {
+        qDebug() << "创建月度汇总表失败:" << query.lastError();
+        return false;
+    }
+
+    // 5. 【新增】实况观测日志 (只追加)
+    // 主键 (city_id, ts) + WITHOUT ROWID：同一城市的观测按时间连续存放，
+    // "某城市最近 24 小时" 只是一段主键范围扫描；同一次观测重复拉到会被主键去重
+    QString sqlObs = "CREATE TABLE IF NOT EXISTS WeatherObservation ("
+                     "city_id TEXT, "
+                     "ts INTEGER, "         // 观测时间 (Unix 秒)
+                     "temp INTEGER, "
+                     "humidity INTEGER, "
+                     "text TEXT, "
+                     "PRIMARY KEY(city_id, ts)) WITHOUT ROWID";
+
+    if (!query.exec(sqlObs)) {
+        qDebug() << "创建观测表失败:" << query.lastError();
+        return false;
+    }
+
+    m_observationFlushTimer = new QTimer(this);
+    m_observationFlushTimer->setSingleShot(true);
+    m_observationFlushTimer->setInterval(OBSERVATION_FLUSH_MS);
+    connect(m_observationFlushTimer, &QTimer::timeout, this, &DBManager::flushObservations);
+    // 退出前把还没落盘的观测写掉
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &DBManager::flushObservations);
+
+    // 6. 【新增】预报存档：同一目标日期，不同提前天数的预报分别保留
+    QString sqlVintage = "CREATE TABLE IF NOT EXISTS ForecastVintage ("
                          "city_id TEXT, "
-                         "date TEXT, "
+                         "target_day INTEGER, "  // 预报的是哪一天 (儒略日)
+                         "lead INTEGER, "        // 提前几天发布 (0 = 当天)
+                         "issue_day INTEGER, "   // 发布日 (儒略日) = target_day - lead
                          "high INTEGER, "
                          "low INTEGER, "
-                         "PRIMARY KEY(city_id, date))"; // <--- 联合主键，防止重复
+                         "scored INTEGER NOT NULL DEFAULT 0, "  // 1 = 已计入评分 (或实际值缺失，已放弃)
+                         "PRIMARY KEY(city_id, target_day, lead)) WITHOUT ROWID";
+
+    // 评分结果：累加误差和，MAE/偏差在读取时再除以样本数，所以可以增量累加
+    QString sqlScore = "CREATE TABLE IF NOT EXISTS ForecastScore ("
+                       "city_id TEXT, "
+                       "lead INTEGER, "
+                       "samples INTEGER, "
+                       "sum_err_high INTEGER, "
+                       "sum_abs_high INTEGER, "
+                       "sum_err_low INTEGER, "
+                       "sum_abs_low INTEGER, "
+                       "PRIMARY KEY(city_id, lead)) WITHOUT ROWID";
+
+    if (!query.exec(sqlVintage) || !query.exec(sqlScore) || !migrateForecastScoring()
+        || !query.exec("CREATE INDEX IF NOT EXISTS idx_vintage_target ON ForecastVintage(target_day)")
+        // 待评分的行单独建部分索引，评分时不用扫已经评过的存档
+        || !query.exec("CREATE INDEX IF NOT EXISTS idx_vintage_unscored "
+                       "ON ForecastVintage(city_id, target_day) WHERE scored = 0")) {
+        qDebug() << "创建预报评分表失败:" << query.lastError();
+        return false;
+    }
+
+    // 7. 【新增】城市位置 (行政区划来自心知 location.path，坐标来自城市字典)
+    // 以及按区域预先算好的月度汇总，区域看板直接读汇总，不扫逐日历史
+    QString sqlLocation = "CREATE TABLE IF NOT EXISTS CityLocation ("
+                          "city_id TEXT PRIMARY KEY, "
+                          "name TEXT, "
+                          "path TEXT, "      // 例如 "海淀,北京,北京,中国"
+                          "country TEXT, "
+                          "lat REAL, "
+                          "lon REAL) WITHOUT ROWID";
 
-    if (!query.exec(sqlHistory)) {
-        qDebug() << "创建历史表失败:" << query.lastError();
+    QString sqlRegion = "CREATE TABLE IF NOT EXISTS RegionMonthly ("
+                        "region TEXT, "      // 路径后缀，例如 "北京,中国"、"中国"
+                        "month INTEGER, "    // yyyyMM
+                        "cities INTEGER, "
+                        "days INTEGER, "
+                        "avg_high REAL, "
+                        "avg_low REAL, "
+                        "max_high INTEGER, "
+                        "min_low INTEGER, "
+                        "PRIMARY KEY(region, month)) WITHOUT ROWID";
+
+    if (!query.exec(sqlLocation) || !query.exec(sqlRegion) || !loadCityLocations()) {
+        qDebug() << "创建城市位置表失败:" << query.lastError();
         return false;
     }
 
+    // 8. 【新增】定期维护：压缩旧年份、清理过期缓存、增量回收空间
+    m_maintenanceTimer = new QTimer(this);
+    m_maintenanceTimer->setInterval(MAINTENANCE_INTERVAL_MS);
+    connect(m_maintenanceTimer, &QTimer::timeout, this, &DBManager::runMaintenance);
+    m_maintenanceTimer->start();
+    // 启动后稍等再跑第一次，不和界面初始化抢时间
+    QTimer::singleShot(10 * 1000, this, &DBManager::runMaintenance);
+
+    // 只读连接池在工作线程里开连接，路径在这里 (主线程) 交给它一份
+    DBReadPool::getInstance().setDatabasePath(dbPath);
+
     qDebug() << "Database init success! Path:" << dbPath;
     return true;
 }
 
+QString DBManager::databasePath()
+{
+    return QCoreApplication::applicationDirPath() + "/weather.db";
+}
+
+bool DBManager::convertToIncrementalVacuum()
+{
+    if (!m_db.isOpen() && !initDB()) return false;
+
+    QSqlQuery query;
+    if (query.exec("PRAGMA auto_vacuum") && query.next() && query.value(0).toInt() == 2) {
+        qDebug() << "已经是增量 VACUUM 模式，无需转换";
+        return true;
+    }
+    query.finish();
+
+    // 转换前先把观测缓冲写掉，VACUUM 不能在事务里执行
+    flushObservations();
+
+    const qint64 sizeBefore = QFileInfo(databasePath()).size();
+    qDebug() << "开始转换增量 VACUUM，数据库大小:" << sizeBefore / (1024 * 1024) << "MB，请耐心等待...";
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!query.exec("PRAGMA auto_vacuum = INCREMENTAL") || !query.exec("VACUUM")) {
+        qDebug() << "切换增量 VACUUM 失败:" << query.lastError();
+        return false;
+    }
+
+    qDebug() << "转换完成，用时" << timer.elapsed() / 1000 << "秒，数据库大小:"
+             << QFileInfo(databasePath()).size() / (1024 * 1024) << "MB";
+    return true;
+}
+
+bool DBManager::checkpointWal()
+{
+    if (!m_db.isOpen()) return false;
+
+    // PASSIVE：不等读连接，能写回多少写回多少，不会卡住界面线程
+    QSqlQuery query;
+    if (!query.exec("PRAGMA wal_checkpoint(PASSIVE)")) {
+        qDebug() << "WAL 检查点失败:" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool DBManager::commitTransaction()
+{
+    if (m_db.commit()) return true;
+
+    qDebug() << "提交事务失败:" << m_db.lastError();
+    m_db.rollback();
+    return false;
+}
+
 bool DBManager::cacheWeather(const QString &cityId, const QString &cityName, const QByteArray &jsonData)
 {
     if (!m_db.isOpen() && !initDB()) return false;
@@ -120,56 +313,329 @@ QByteArray DBManager::getWeatherCache(const QString &cityId)
     return QByteArray();
 }
 
+bool DBManager::touchWeatherCache(const QString &cityId)
+{
+    if (!m_db.isOpen() && !initDB()) return false;
+
+    QSqlQuery query;
+    query.prepare("UPDATE WeatherCache SET last_update = :time WHERE city_id = :id");
+    query.bindValue(":time", QDateTime::currentDateTime());
+    query.bindValue(":id", cityId);
+
+    if (!query.exec()) {
+        qDebug() << "Error: Failed to touch cache" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
 // 【新增】插入逻辑
 bool DBManager::insertHistoryData(const QString &cityId, const QString &date, int high, int low)
+{
+    QDate day = QDate::fromString(date, "yyyy-MM-dd");
+    if (!day.isValid()) {
+        qDebug() << "❌ 日期格式不正确:" << cityId << date;
+        return false;
+    }
+    return insertHistoryDay(cityId, day, high, low);
+}
+
+bool DBManager::insertHistoryDay(const QString &cityId, const QDate &day, int high, int low)
 {
     if (!m_db.isOpen() && !initDB()) return false;
 
+    m_historyStats.requested++;
+
+    // 0. 已压缩的年份不再写逐日数据：否则会把那一年的分表重新建出来，
+    //    下次维护压缩时就会用这几行覆盖掉原来的月度汇总
+    if (day.year() < oldestKeptYear()) {
+        m_historyStats.skippedExpired++;
+        return true;
+    }
+
+    // 1. 内存摘要：和上次写进去的一样，直接跳过
+    auto cityIt = m_historyDigest.constFind(cityId);
+    if (cityIt != m_historyDigest.constEnd()) {
+        auto dayIt = cityIt->constFind(day.toJulianDay());
+        if (dayIt != cityIt->constEnd() && dayIt->first == high && dayIt->second == low) {
+            m_historyStats.skippedByDigest++;
+            return true;
+        }
+    }
+
+    // 2. 摘要里没有 (比如刚启动) 或值变了，交给 SQLite 判断
+    return upsertHistory(cityId, day, high, low) >= 0;
+}
+
+int DBManager::saveForecast(const QString &cityId, const QList<DayWeather> &forecast,
+                            const QDate &issueDate)
+{
+    if (!m_db.isOpen() && !initDB()) return -1;
+
+    const quint64 writtenBefore = m_historyStats.written;
+
+    // 几天的数据放在一个事务里，只提交一次
+    m_db.transaction();
+    for (const DayWeather &day : forecast) {
+        if (!insertHistoryData(cityId, day.date, day.high, day.low)) {
+            m_db.rollback();
+            // 回滚后摘要可能和库里不一致，清掉这个城市的摘要，下次以库为准
+            m_historyDigest.remove(cityId);
+            m_historyStats.written = writtenBefore;
+            // 事务里新建的分表也一起回滚了，重新读一遍分表列表
+            loadHistoryPartitions();
+            return -1;
+        }
+    }
+    // 【新增】同时按发布日存档，用于之后的准确度评分
+    if (!saveForecastVintage(cityId, forecast, issueDate) || !commitTransaction()) {
+        m_db.rollback();  // 提交失败时已经回滚过，再调一次没有副作用
+        // 摘要是在事务里更新的，没提交成功就不能再信它，下次以库为准
+        m_historyDigest.remove(cityId);
+        m_vintageDigest.remove(cityId);
+        m_historyStats.written = writtenBefore;
+        loadHistoryPartitions();
+        return -1;
+    }
+    pruneHistoryDigest(cityId);
+
+    return int(m_historyStats.written - writtenBefore);
+}
+
+void DBManager::pruneHistoryDigest(const QString &cityId)
+{
+    auto cityIt = m_historyDigest.find(cityId);
+    if (cityIt == m_historyDigest.end()) return;
+
+    const qint64 today = QDate::currentDate().toJulianDay();
+    for (auto it = cityIt->begin(); it != cityIt->end();) {
+        if (it.key() < today) it = cityIt->erase(it);
+        else ++it;
+    }
+    if (cityIt->isEmpty()) m_historyDigest.erase(cityIt);
+}
+
+int DBManager::saveParsedBatch(const ParsedBatch &batch)
+{
+    if (!m_db.isOpen() && !initDB()) return -1;
+
+    const quint64 writtenBefore = m_historyStats.written;
+
+    // 整批只开一个事务
+    m_db.transaction();
+    for (int c = 0; c < batch.cityIds.size(); ++c) {
+        if (!batch.ok[c]) continue;
+
+        const QString &cityId = batch.cityIds[c];
+        QList<DayWeather> vintage;
+
+        for (int i = batch.dayOffsets[c]; i < batch.dayOffsets[c + 1]; ++i) {
+            const CompactDay &d = batch.days[i];
+            const QDate date = QDate::fromJulianDay(d.julianDay);
+            if (!insertHistoryDay(cityId, date, d.high, d.low)) {
+                m_db.rollback();
+                m_historyDigest.clear();
+                m_vintageDigest.clear();
+                m_historyStats.written = writtenBefore;
+                loadHistoryPartitions();
+                return -1;
+            }
+
+            DayWeather day;
+            day.date = date.toString("yyyy-MM-dd");
+            day.high = d.high;
+            day.low = d.low;
+            vintage.append(day);
+        }
+
+        // 按 payload 自己的发布日存档；不知道发布日就不存 (按今天算会把提前天数全标错)
+        const qint32 issueDay = batch.issueDays[c];
+        if (issueDay > 0 && !saveForecastVintage(cityId, vintage, QDate::fromJulianDay(issueDay))) {
+            m_db.rollback();
+            m_historyDigest.clear();
+            m_vintageDigest.clear();
+            m_historyStats.written = writtenBefore;
+            loadHistoryPartitions();
+            return -1;
+        }
+    }
+    if (!commitTransaction()) {
+        m_historyDigest.clear();
+        m_vintageDigest.clear();
+        m_historyStats.written = writtenBefore;
+        loadHistoryPartitions();
+        return -1;
+    }
+    for (const QString &cityId : batch.cityIds) pruneHistoryDigest(cityId);
+
+    return int(m_historyStats.written - writtenBefore);
+}
+
+int DBManager::upsertHistory(const QString &cityId, const QDate &day, int high, int low)
+{
+    // 按年份写进对应的分表 (没有就建)
+    if (!ensureHistoryPartition(day.year())) return -1;
+
     QSqlQuery query;
-    QString sql = "INSERT OR REPLACE INTO WeatherHistory (city_id, date, high, low) "
-                  "VALUES (:cityid, :date, :high, :low)";
+    // 【修改】不再用 INSERT OR REPLACE (那是先删后插，每次都写)
+    // ON CONFLICT ... DO UPDATE ... WHERE：只有高温/低温真的变了才更新
+    QString sql = QString("INSERT INTO %1 (city_id, day, high, low) "
+                          "VALUES (:cityid, :day, :high, :low) "
+                          "ON CONFLICT(city_id, day) DO UPDATE SET high = excluded.high, low = excluded.low "
+                          "WHERE high != excluded.high OR low != excluded.low")
+                      .arg(historyPartition(day.year()));
 
     query.prepare(sql);
     query.bindValue(":cityid", cityId);
-    query.bindValue(":date", date);
+    query.bindValue(":day", day.toJulianDay());
     query.bindValue(":high", high);
     query.bindValue(":low", low);
 
-    bool success = query.exec(); // 执行
-
-    // 【新增调试代码】
-    if (!success) {
+    if (!query.exec()) {
         // 如果插入失败，打印具体原因！
-        qDebug() << "❌ 插入历史失败! ID:" << cityId << " Date:" << date
+        qDebug() << "❌ 插入历史失败! ID:" << cityId << " Date:" << day
                  << " Error:" << query.lastError().text();
-    } else {
-        // 如果成功，也打印一下，确认真的插进去了
-        qDebug() << "✅ 插入成功: " << cityId << date;
+        return -1;
     }
 
-    return success;
+    // 不管写没写，库里的值现在都等于 (high, low)，更新摘要
+    m_historyDigest[cityId].insert(day.toJulianDay(), qMakePair(high, low));
+    m_citiesWithHistory.insert(cityId);
+
+    if (query.numRowsAffected() > 0) {
+        m_historyStats.written++;
+        qDebug() << "✅ 写入历史: " << cityId << day;
+        return 1;
+    }
+
+    m_historyStats.skippedBySqlite++;
+    return 0;
 }
 
 // 【新增】查询逻辑
 QList<DayWeather> DBManager::getHistoryData(const QString &cityId)
+{
+    if (!m_db.isOpen() && !initDB()) return QList<DayWeather>();
+    if (m_historyYears.isEmpty()) return QList<DayWeather>();
+
+    // 全部年份，按年份从早到晚拼起来
+    return getHistoryRange(cityId, QDate(m_historyYears.first(), 1, 1),
+                           QDate(m_historyYears.last(), 12, 31));
+}
+
+QList<DayWeather> DBManager::getHistoryRange(const QString &cityId, const QDate &from, const QDate &to)
+{
+    if (!m_db.isOpen() && !initDB()) return QList<DayWeather>();
+
+    return queryHistoryRange(m_db, m_historyYears, cityId, from, to);
+}
+
+QList<DayWeather> DBManager::queryHistoryRange(const QSqlDatabase &db, const QList<int> &years,
+                                               const QString &cityId, const QDate &from, const QDate &to)
 {
     QList<DayWeather> list;
+
+    // 分区裁剪：只查 [from, to] 覆盖到的年份的分表
+    for (int year : years) {
+        if (year < from.year() || year > to.year()) continue;
+
+        QSqlQuery query(db);
+        // 按日期升序排列，这样画图时线是顺的
+        query.prepare(QString("SELECT day, high, low FROM %1 "
+                              "WHERE city_id = :id AND day BETWEEN :from AND :to ORDER BY day ASC")
+                          .arg(historyPartition(year)));
+        query.bindValue(":id", cityId);
+        query.bindValue(":from", from.toJulianDay());
+        query.bindValue(":to", to.toJulianDay());
+
+        if (!query.exec()) {
+            qDebug() << "查询历史失败:" << query.lastError();
+            continue;
+        }
+        while (query.next()) {
+            // 注意：历史表里没存 week 和 type，如果需要也可以加上，这里主要为了画图
+            list.append(dayFromRow(query));
+        }
+    }
+    return list;
+}
+
+void DBManager::appendObservation(const QString &cityId, const TodayWeather &weather)
+{
+    if (weather.wendu.isEmpty()) return;
+
+    NowObservation obs;
+    // 优先用接口给的观测时间，这样同一次观测重复拉到时时间戳一致，能被主键去重
+    QDateTime time = QDateTime::fromString(weather.updateTime, Qt::ISODate);
+    obs.time = time.isValid() ? time.toSecsSinceEpoch() : QDateTime::currentSecsSinceEpoch();
+    obs.temp = weather.wendu.toInt();
+    obs.humidity = weather.shidu.toInt();
+    obs.text = weather.type;
+
+    m_pendingObservations.append(qMakePair(cityId, obs));
+
+    if (m_pendingObservations.size() >= OBSERVATION_BATCH_SIZE) {
+        flushObservations();
+    } else if (m_observationFlushTimer && !m_observationFlushTimer->isActive()) {
+        m_observationFlushTimer->start();
+    }
+}
+
+bool DBManager::flushObservations()
+{
+    if (m_observationFlushTimer) m_observationFlushTimer->stop();
+    if (m_pendingObservations.isEmpty()) return true;
+    if (!m_db.isOpen() && !initDB()) return false;
+
+    // 一批观测放在一个事务里，语句只 prepare 一次
+    m_db.transaction();
+    QSqlQuery query;
+    query.prepare("INSERT OR IGNORE INTO WeatherObservation (city_id, ts, temp, humidity, text) "
+                  "VALUES (:id, :ts, :temp, :hum, :text)");
+
+    for (const auto &item : std::as_const(m_pendingObservations)) {
+        query.bindValue(":id", item.first);
+        query.bindValue(":ts", item.second.time);
+        query.bindValue(":temp", item.second.temp);
+        query.bindValue(":hum", item.second.humidity);
+        query.bindValue(":text", item.second.text);
+        if (!query.exec()) {
+            qDebug() << "写入观测失败:" << query.lastError();
+            m_db.rollback();
+            return false;  // 保留缓冲，下次再试
+        }
+    }
+    if (!commitTransaction()) return false;  // 同样保留缓冲
+
+    m_pendingObservations.clear();
+    return true;
+}
+
+QList<NowObservation> DBManager::getRecentObservations(const QString &cityId, int hours)
+{
+    QList<NowObservation> list;
     if (!m_db.isOpen() && !initDB()) return list;
 
+    // 先把缓冲里的写进去，保证能查到刚拉到的数据
+    flushObservations();
+
     QSqlQuery query;
-    // 按日期升序排列，这样画图时线是顺的
-    query.prepare("SELECT date, high, low FROM WeatherHistory WHERE city_id = :id ORDER BY date ASC");
+    query.prepare("SELECT ts, temp, humidity, text FROM WeatherObservation "
+                  "WHERE city_id = :id AND ts >= :from ORDER BY ts ASC");
     query.bindValue(":id", cityId);
+    query.bindValue(":from", QDateTime::currentSecsSinceEpoch() - qint64(hours) * 3600);
 
     if (query.exec()) {
         while (query.next()) {
-            DayWeather day;
-            day.date = query.value("date").toString();
-            day.high = query.value("high").toInt();
-            day.low = query.value("low").toInt();
-            // 注意：历史表里没存 week 和 type，如果需要也可以加上，这里主要为了画图
-            list.append(day);
+            NowObservation obs;
+            obs.time = query.value(0).toLongLong();
+            obs.temp = query.value(1).toInt();
+            obs.humidity = query.value(2).toInt();
+            obs.text = query.value(3).toString();
+            list.append(obs);
         }
+    } else {
+        qDebug() << "查询观测失败:" << query.lastError();
     }
     return list;
 }
@@ -180,41 +646,36 @@ QSqlDatabase DBManager::getDatabase()
 }
 
 
-// dbmanager.cpp
-
 QList<DayWeather> DBManager::getRecentHistory(const QString &cityId)
 {
     QList<DayWeather> list;
     if (!m_db.isOpen() && !initDB()) return list;
 
-    QSqlQuery query;
-
-    // 获取今天的日期 (yyyy-MM-dd)
-    QString today = QDateTime::currentDateTime().toString("yyyy-MM-dd");
-
-    // 【核心 SQL 语句】
-    // 1. 内层查询：WHERE date < :today (只找以前的)，ORDER BY date DESC (找离今天最近的)，LIMIT 6 (只取6条)
-    // 2. 外层查询：把找出来的这 6 条，重新 ORDER BY date ASC (按时间正序排列，方便画图)
-    QString sql = "SELECT * FROM ("
-                  "  SELECT date, high, low FROM WeatherHistory "
-                  "  WHERE city_id = :cityid AND date < :today "
-                  "  ORDER BY date DESC LIMIT 6"
-                  ") ORDER BY date ASC";
+    const int wanted = 6;
+    // 今天的儒略日，排除今天和未来
+    const qint64 today = QDate::currentDate().toJulianDay();
 
-    query.prepare(sql);
-    query.bindValue(":cityid", cityId);
-    query.bindValue(":today", today); // 排除今天和未来
+    // 【修改】从今年往前逐年查，凑够 6 条就停，更早的分表根本不会碰
+    for (int i = m_historyYears.size() - 1; i >= 0 && list.size() < wanted; --i) {
+        QSqlQuery query;
+        query.prepare(QString("SELECT day, high, low FROM %1 "
+                              "WHERE city_id = :cityid AND day < :today "
+                              "ORDER BY day DESC LIMIT :limit")
+                          .arg(historyPartition(m_historyYears[i])));
+        query.bindValue(":cityid", cityId);
+        query.bindValue(":today", today);
+        query.bindValue(":limit", wanted - list.size());
 
-    if (query.exec()) {
+        if (!query.exec()) {
+            qDebug() << "查询历史失败:" << query.lastError();
+            break;
+        }
+        // 倒序查出来的，插到前面，保证最终按时间正序 (方便画图)
+        QList<DayWeather> chunk;
         while (query.next()) {
-            DayWeather day;
-            day.date = query.value("date").toString();
-            day.high = query.value("high").toInt();
-            day.low = query.value("low").toInt();
-            list.append(day);
+            chunk.prepend(dayFromRow(query));
         }
-    } else {
-        qDebug() << "查询历史失败:" << query.lastError();
+        list = chunk + list;
     }
     return list;
 }
@@ -235,3 +696,726 @@ QString DBManager::getCityName(const QString &cityId)
     }
     return cityId; // 如果查不到（或者没缓存），就这就返回拼音
 }
+
+QList<MonthWeather> DBManager::getMonthlyHistory(const QString &cityId)
+{
+    QList<MonthWeather> list;
+    if (!m_db.isOpen() && !initDB()) return list;
+
+    QSqlQuery query;
+    query.prepare("SELECT month, avg_high, avg_low, max_high, min_low, days "
+                  "FROM WeatherHistoryMonthly WHERE city_id = :id ORDER BY month ASC");
+    query.bindValue(":id", cityId);
+
+    if (query.exec()) {
+        while (query.next()) {
+            MonthWeather m;
+            m.month = query.value(0).toInt();
+            m.avgHigh = query.value(1).toDouble();
+            m.avgLow = query.value(2).toDouble();
+            m.maxHigh = query.value(3).toInt();
+            m.minLow = query.value(4).toInt();
+            m.days = query.value(5).toInt();
+            list.append(m);
+        }
+    }
+    return list;
+}
+
+// ======================= 历史分表 =======================
+
+QString DBManager::historyPartition(int year)
+{
+    return QString("WeatherHistory_%1").arg(year);
+}
+
+DayWeather DBManager::dayFromRow(const QSqlQuery &query)
+{
+    // 列顺序固定为 day, high, low
+    DayWeather day;
+    day.date = QDate::fromJulianDay(query.value(0).toLongLong()).toString("yyyy-MM-dd");
+    day.high = query.value(1).toInt();
+    day.low = query.value(2).toInt();
+    return day;
+}
+
+bool DBManager::loadHistoryPartitions()
+{
+    m_historyYears.clear();
+
+    QSqlQuery query;
+    if (!query.exec("SELECT name FROM sqlite_master "
+                    "WHERE type = 'table' AND name LIKE 'WeatherHistory\\_%' ESCAPE '\\'")) {
+        return false;
+    }
+    while (query.next()) {
+        bool ok = false;
+        int year = query.value(0).toString().mid(QString("WeatherHistory_").size()).toInt(&ok);
+        if (ok) m_historyYears.append(year);
+    }
+    std::sort(m_historyYears.begin(), m_historyYears.end());
+    return true;
+}
+
+bool DBManager::ensureHistoryPartition(int year)
+{
+    if (m_historyYears.contains(year)) return true;
+
+    return createHistoryPartition(year) && rebuildHistoryView();
+}
+
+bool DBManager::createHistoryPartition(int year)
+{
+    if (m_historyYears.contains(year)) return true;
+
+    // WITHOUT ROWID：数据直接按 (city_id, day) 聚簇存储，按城市查一段日期只读连续的页
+    QSqlQuery query;
+    QString sql = QString("CREATE TABLE IF NOT EXISTS %1 ("
+                          "city_id TEXT, "
+                          "day INTEGER, "   // 儒略日
+                          "high INTEGER, "
+                          "low INTEGER, "
+                          "PRIMARY KEY(city_id, day)) WITHOUT ROWID")
+                      .arg(historyPartition(year));
+    if (!query.exec(sql)) {
+        qDebug() << "创建历史分表失败:" << year << query.lastError();
+        return false;
+    }
+
+    m_historyYears.append(year);
+    std::sort(m_historyYears.begin(), m_historyYears.end());
+    return true;
+}
+
+bool DBManager::rebuildHistoryView()
+{
+    // 界面上的表格 (QSqlTableModel) 和导出仍然读 WeatherHistory，
+    // 这里用视图把各年分表拼回原来的列 (city_id, date, high, low)
+    QStringList parts;
+    for (int year : std::as_const(m_historyYears)) {
+        parts << QString("SELECT city_id, date(day) AS date, high, low FROM %1")
+                     .arg(historyPartition(year));
+    }
+    if (parts.isEmpty()) {
+        parts << "SELECT '' AS city_id, '' AS date, 0 AS high, 0 AS low WHERE 0";
+    }
+
+    QSqlQuery query;
+    if (!query.exec("DROP VIEW IF EXISTS WeatherHistory")
+        || !query.exec("CREATE VIEW WeatherHistory AS " + parts.join(" UNION ALL "))) {
+        qDebug() << "重建历史视图失败:" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool DBManager::migrateLegacyHistory()
+{
+    // 老版本的 WeatherHistory 是一张真正的表 (TEXT 日期)
+    QSqlQuery query;
+    if (!query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'WeatherHistory'")) {
+        return false;
+    }
+    if (!query.next()) return true; // 没有旧表，不用迁移
+    query.finish();
+
+    qDebug() << "迁移旧版历史表到按年分表...";
+    m_db.transaction();
+
+    QList<int> years;
+    if (query.exec("SELECT DISTINCT CAST(substr(date, 1, 4) AS INTEGER) FROM WeatherHistory")) {
+        while (query.next()) years.append(query.value(0).toInt());
+    }
+    query.finish();
+
+    for (int year : std::as_const(years)) {
+        if (year <= 0) continue;
+        if (!createHistoryPartition(year)) {
+            m_db.rollback();
+            return false;
+        }
+        // julianday() 得到的是当天 0 点 (x.5)，+0.5 取整后与 QDate::toJulianDay 一致
+        QString sql = QString("INSERT OR IGNORE INTO %1 (city_id, day, high, low) "
+                              "SELECT city_id, CAST(julianday(date) + 0.5 AS INTEGER), high, low "
+                              "FROM WeatherHistory WHERE substr(date, 1, 4) = '%2'")
+                          .arg(historyPartition(year))
+                          .arg(year, 4, 10, QChar('0'));
+        if (!query.exec(sql)) {
+            qDebug() << "迁移历史失败:" << year << query.lastError();
+            m_db.rollback();
+            loadHistoryPartitions();
+            return false;
+        }
+    }
+
+    if (!query.exec("DROP TABLE WeatherHistory") || !rebuildHistoryView()) {
+        m_db.rollback();
+        loadHistoryPartitions();
+        return false;
+    }
+    if (!commitTransaction()) {
+        loadHistoryPartitions();
+        return false;
+    }
+    return true;
+}
+
+// ======================= 保留策略 / 维护 =======================
+
+void DBManager::runMaintenance()
+{
+    if (!m_db.isOpen()) return;
+
+    scoreForecasts();
+    compactOldHistory();
+    refreshRegionRollup();
+    evictStaleCache();
+
+    // 每次只回收一部分空闲页，避免一次性长时间占用数据库
+    QSqlQuery query;
+    if (!query.exec(QString("PRAGMA incremental_vacuum(%1)").arg(INCREMENTAL_VACUUM_PAGES))) {
+        qDebug() << "增量 VACUUM 失败:" << query.lastError();
+    }
+    // incremental_vacuum 每回收一页返回一行，要把结果读完才会真正执行完
+    while (query.next()) {}
+}
+
+int DBManager::compactOldHistory()
+{
+    // 今年 + 往前 HISTORY_KEEP_YEARS 年保留逐日数据，更早的压缩成月度汇总
+    const int oldestKept = oldestKeptYear();
+
+    QList<int> expired;
+    for (int year : std::as_const(m_historyYears)) {
+        if (year < oldestKept) expired.append(year);
+    }
+    if (expired.isEmpty()) return 0;
+
+    int compacted = 0;
+    for (int year : std::as_const(expired)) {
+        const QString table = historyPartition(year);
+
+        m_db.transaction();
+        QSqlQuery query;
+        // strftime 可以直接吃儒略日数字
+        QString sql = QString("INSERT INTO WeatherHistoryMonthly "
+                              "(city_id, month, avg_high, avg_low, max_high, min_low, days) "
+                              "SELECT city_id, CAST(strftime('%Y%m', day) AS INTEGER), "
+                              "AVG(high), AVG(low), MAX(high), MIN(low), COUNT(*) "
+                              "FROM %1 WHERE 1 GROUP BY 1, 2 "
+                              "ON CONFLICT(city_id, month) DO UPDATE SET "
+                              "avg_high = excluded.avg_high, avg_low = excluded.avg_low, "
+                              "max_high = excluded.max_high, min_low = excluded.min_low, "
+                              "days = excluded.days")
+                          .arg(table);
+
+        if (!query.exec(sql) || !query.exec("DROP TABLE " + table)) {
+            qDebug() << "压缩历史失败:" << year << query.lastError();
+            m_db.rollback();
+            continue;
+        }
+        m_historyYears.removeAll(year);
+        if (!rebuildHistoryView()) {
+            m_db.rollback();
+            loadHistoryPartitions();
+            continue;
+        }
+        if (!commitTransaction()) {
+            loadHistoryPartitions();
+            continue;
+        }
+
+        qDebug() << "已压缩历史年份:" << year;
+        ++compacted;
+    }
+    return compacted;
+}
+
+int DBManager::evictStaleCache()
+{
+    QSqlQuery query;
+    query.prepare("DELETE FROM WeatherCache WHERE last_update < :cutoff");
+    query.bindValue(":cutoff", QDateTime::currentDateTime().addDays(-CACHE_RETENTION_DAYS));
+
+    if (!query.exec()) {
+        qDebug() << "清理过期缓存失败:" << query.lastError();
+        return 0;
+    }
+    int removed = query.numRowsAffected();
+    if (removed > 0) qDebug() << "已清理过期缓存:" << removed << "条";
+    return removed;
+}
+
+// ======================= 预报存档 / 准确度评分 =======================
+
+bool DBManager::saveForecastVintage(const QString &cityId, const QList<DayWeather> &forecast,
+                                    const QDate &issueDate)
+{
+    // 不知道发布日就没法算提前天数，跳过 (不算失败)
+    if (!issueDate.isValid()) return true;
+    if (!m_db.isOpen() && !initDB()) return false;
+
+    const qint64 issueDay = issueDate.toJulianDay();
+
+    // 和上一次写入的批次完全一样 (同一发布日、同样的数值)，跳过
+    QString digest = QString::number(issueDay);
+    for (const DayWeather &day : forecast) {
+        digest += QString("|%1:%2:%3").arg(day.date).arg(day.high).arg(day.low);
+    }
+    if (m_vintageDigest.value(cityId) == digest) return true;
+
+    QSqlQuery query;
+    // 同一天多次刷新：保留当天最后一次的预报，值没变就不写
+    query.prepare("INSERT INTO ForecastVintage (city_id, target_day, lead, issue_day, high, low) "
+                  "VALUES (:id, :target, :lead, :issue, :high, :low) "
+                  "ON CONFLICT(city_id, target_day, lead) DO UPDATE SET "
+                  "high = excluded.high, low = excluded.low "
+                  "WHERE scored = 0 AND (high != excluded.high OR low != excluded.low)");
+
+    for (const DayWeather &day : forecast) {
+        QDate target = QDate::fromString(day.date, "yyyy-MM-dd");
+        if (!target.isValid()) continue;
+
+        const qint64 lead = target.toJulianDay() - issueDay;
+        if (lead < 0) continue; // 缓存里的旧数据，目标日期已经过去
+
+        query.bindValue(":id", cityId);
+        query.bindValue(":target", target.toJulianDay());
+        query.bindValue(":lead", lead);
+        query.bindValue(":issue", issueDay);
+        query.bindValue(":high", day.high);
+        query.bindValue(":low", day.low);
+        if (!query.exec()) {
+            qDebug() << "保存预报存档失败:" << cityId << day.date << query.lastError();
+            return false;
+        }
+    }
+
+    m_vintageDigest.insert(cityId, digest);
+    return true;
+}
+
+bool DBManager::migrateForecastScoring()
+{
+    // 老库：评分进度原来是一条水位线 (ForecastScoreState)，而且 "实际值" 取的是历史表
+    // (那其实是当天的预报)。改成逐行标记 scored，旧的评分结果作废，按观测重新评
+    QSqlQuery query;
+    if (!query.exec("PRAGMA table_info(ForecastVintage)")) return false;
+    while (query.next()) {
+        if (query.value("name").toString() == "scored") return true;
+    }
+    query.finish();
+
+    qDebug() << "升级预报评分表：旧评分作废，按实况观测重新评分";
+    return query.exec("ALTER TABLE ForecastVintage ADD COLUMN scored INTEGER NOT NULL DEFAULT 0")
+           && query.exec("DELETE FROM ForecastScore")
+           && query.exec("DROP TABLE IF EXISTS ForecastScoreState");
+}
+
+int DBManager::scoreForecasts()
+{
+    if (!m_db.isOpen() && !initDB()) return 0;
+
+    // 实际值来自观测日志，缓冲里还没落盘的先写掉
+    flushObservations();
+
+    // 只评到昨天：今天的观测还不完整
+    const qint64 upTo = QDate::currentDate().addDays(-1).toJulianDay();
+    // 观测按本地日期归到某一天 (ts 是 UTC 秒)
+    const int utcOffset = QDateTime::currentDateTime().offsetFromUtc();
+
+    m_db.transaction();
+    QSqlQuery query;
+
+    // 1. 待评分的存档涉及到的 (城市, 日期) 的实际最高/最低温：取该日观测的最大/最小值，
+    //    观测太少 (比如只开过一次程序) 的日子不算，免得把某个时刻的温度当成全天最高温
+    //    只按每个城市待评分的日期范围扫观测主键，不扫整张表
+    //    (儒略日 2440588 = 1970-01-01；时区偏移放进 CTE，只绑定一次)
+    QString sqlActual = "WITH k(off) AS (SELECT :offset) "
+                        "INSERT INTO temp.ScoreActual (city_id, day, high, low) "
+                        "SELECT o.city_id, (o.ts + k.off) / 86400 + 2440588 AS d, MAX(o.temp), MIN(o.temp) "
+                        "FROM k, (SELECT city_id, MIN(target_day) AS lo, MAX(target_day) AS hi "
+                        "         FROM ForecastVintage WHERE scored = 0 AND target_day <= :to GROUP BY city_id) p "
+                        "JOIN WeatherObservation o ON o.city_id = p.city_id "
+                        "AND o.ts >= (p.lo - 2440588) * 86400 - k.off "
+                        "AND o.ts < (p.hi - 2440587) * 86400 - k.off "
+                        "GROUP BY o.city_id, d HAVING COUNT(*) >= :minObs";
+
+    // 2. 有实际值的待评分存档累加进评分表 (所有提前天数，包括当天发布的)
+    QString sqlAccumulate = "INSERT INTO ForecastScore "
+                       "(city_id, lead, samples, sum_err_high, sum_abs_high, sum_err_low, sum_abs_low) "
+                       "SELECT f.city_id, f.lead, COUNT(*), "
+                       "SUM(f.high - a.high), SUM(ABS(f.high - a.high)), "
+                       "SUM(f.low - a.low), SUM(ABS(f.low - a.low)) "
+                       "FROM ForecastVintage f JOIN temp.ScoreActual a "
+                       "ON a.city_id = f.city_id AND a.day = f.target_day "
+                       "WHERE f.scored = 0 AND f.target_day <= :to "
+                       "GROUP BY f.city_id, f.lead "
+                       "ON CONFLICT(city_id, lead) DO UPDATE SET "
+                       "samples = samples + excluded.samples, "
+                       "sum_err_high = sum_err_high + excluded.sum_err_high, "
+                       "sum_abs_high = sum_abs_high + excluded.sum_abs_high, "
+                       "sum_err_low = sum_err_low + excluded.sum_err_low, "
+                       "sum_abs_low = sum_abs_low + excluded.sum_abs_low";
+
+    // 3. 标记已评分 (与累加在同一事务里，保证不会重复累加)；
+    //    过了宽限期还没有实际值的 (那几天没有足够的观测) 也标记掉，以后不再尝试
+    QString sqlMark = "UPDATE ForecastVintage SET scored = 1 "
+                      "WHERE scored = 0 AND target_day <= :to AND (target_day < :giveUp "
+                      "OR EXISTS (SELECT 1 FROM temp.ScoreActual a "
+                      "           WHERE a.city_id = ForecastVintage.city_id AND a.day = ForecastVintage.target_day))";
+
+    int samples = 0;
+    bool ok = query.exec("CREATE TEMP TABLE IF NOT EXISTS ScoreActual ("
+                         "city_id TEXT, day INTEGER, high INTEGER, low INTEGER, "
+                         "PRIMARY KEY(city_id, day)) WITHOUT ROWID")
+              && query.exec("DELETE FROM temp.ScoreActual");
+    if (ok) {
+        query.prepare(sqlActual);
+        query.bindValue(":offset", utcOffset);
+        query.bindValue(":to", upTo);
+        query.bindValue(":minObs", SCORE_MIN_OBSERVATIONS);
+        ok = query.exec();
+    }
+    if (ok) {
+        query.prepare("SELECT COUNT(*) FROM ForecastVintage f JOIN temp.ScoreActual a "
+                      "ON a.city_id = f.city_id AND a.day = f.target_day WHERE f.scored = 0");
+        if (query.exec() && query.next()) samples = query.value(0).toInt();
+        query.finish();
+
+        query.prepare(sqlAccumulate);
+        query.bindValue(":to", upTo);
+        ok = query.exec();
+    }
+    if (ok) {
+        query.prepare(sqlMark);
+        query.bindValue(":to", upTo);
+        query.bindValue(":giveUp", upTo - SCORE_GRACE_DAYS);
+        ok = query.exec();
+    }
+    if (!ok) {
+        qDebug() << "预报评分失败:" << query.lastError();
+        m_db.rollback();
+        return 0;
+    }
+    if (!commitTransaction()) return 0;
+
+    if (samples > 0) qDebug() << "预报评分完成，新评分:" << samples << "条";
+    return samples;
+}
+
+QList<ForecastScore> DBManager::getForecastScores(const QString &cityId)
+{
+    QList<ForecastScore> list;
+    if (!m_db.isOpen() && !initDB()) return list;
+
+    QSqlQuery query;
+    query.prepare("SELECT lead, samples, sum_err_high, sum_abs_high, sum_err_low, sum_abs_low "
+                  "FROM ForecastScore WHERE city_id = :id AND samples > 0 ORDER BY lead ASC");
+    query.bindValue(":id", cityId);
+
+    if (query.exec()) {
+        while (query.next()) {
+            ForecastScore score;
+            score.lead = query.value(0).toInt();
+            score.samples = query.value(1).toInt();
+            const double n = score.samples;
+            score.biasHigh = query.value(2).toDouble() / n;
+            score.maeHigh = query.value(3).toDouble() / n;
+            score.biasLow = query.value(4).toDouble() / n;
+            score.maeLow = query.value(5).toDouble() / n;
+            list.append(score);
+        }
+    } else {
+        qDebug() << "查询预报评分失败:" << query.lastError();
+    }
+    return list;
+}
+
+// ======================= 城市位置 / 区域汇总 =======================
+
+bool DBManager::loadCityLocations()
+{
+    m_cityLocations.clear();
+    m_citiesWithHistory.clear();
+
+    QSqlQuery query;
+    if (!query.exec("SELECT city_id, name, path, country, lat, lon FROM CityLocation")) {
+        return false;
+    }
+    while (query.next()) {
+        CityLocation loc;
+        loc.cityId = query.value(0).toString();
+        loc.name = query.value(1).toString();
+        loc.path = query.value(2).toString();
+        loc.country = query.value(3).toString();
+        if (!query.value(4).isNull()) loc.lat = query.value(4).toDouble();
+        if (!query.value(5).isNull()) loc.lon = query.value(5).toDouble();
+        m_cityLocations.insert(loc);
+    }
+
+    // 有历史数据的城市：各分表和月度汇总表里出现过的 city_id (主键第一列，不用回表)
+    QStringList sources;
+    for (int year : std::as_const(m_historyYears)) {
+        sources << QString("SELECT city_id FROM %1").arg(historyPartition(year));
+    }
+    sources << "SELECT city_id FROM WeatherHistoryMonthly";
+    if (!query.exec("SELECT DISTINCT city_id FROM (" + sources.join(" UNION ALL ") + ")")) {
+        return false;
+    }
+    while (query.next()) {
+        m_citiesWithHistory.insert(query.value(0).toString());
+    }
+
+    // 汇总表还是空的 (第一次启动或刚升级)，第一次维护时全部算一遍
+    if (query.exec("SELECT 1 FROM RegionMonthly LIMIT 1") && !query.next()) {
+        m_regionRollupDirty = true;
+    }
+    return true;
+}
+
+bool DBManager::saveCityLocations(const QList<CityLocation> &locations)
+{
+    if (!m_db.isOpen() && !initDB()) return false;
+
+    // 先在内存里合并，只有真的变了的城市才写库
+    QList<CityLocation> changed;
+    for (const CityLocation &loc : locations) {
+        if (loc.cityId.isEmpty()) continue;
+
+        const CityLocation *old = m_cityLocations.find(loc.cityId);
+        CityLocation merged = old ? *old : CityLocation();
+        merged.cityId = loc.cityId;
+        if (!loc.name.isEmpty()) merged.name = loc.name;
+        if (!loc.path.isEmpty()) merged.path = loc.path;
+        if (!loc.country.isEmpty()) merged.country = loc.country;
+        if (loc.hasCoordinates()) {
+            merged.lat = loc.lat;
+            merged.lon = loc.lon;
+        }
+
+        if (old && old->name == merged.name && old->path == merged.path
+            && old->country == merged.country
+            && old->hasCoordinates() == merged.hasCoordinates()
+            && (!merged.hasCoordinates() || (old->lat == merged.lat && old->lon == merged.lon))) {
+            continue;
+        }
+        // 区划变了，已经算好的区域汇总里这个城市算错了组
+        if ((old ? old->path : QString()) != merged.path) m_regionRollupDirty = true;
+        changed.append(merged);
+    }
+    if (changed.isEmpty()) return true;
+
+    m_db.transaction();
+    QSqlQuery query;
+    query.prepare("INSERT INTO CityLocation (city_id, name, path, country, lat, lon) "
+                  "VALUES (:id, :name, :path, :country, :lat, :lon) "
+                  "ON CONFLICT(city_id) DO UPDATE SET name = excluded.name, path = excluded.path, "
+                  "country = excluded.country, lat = excluded.lat, lon = excluded.lon");
+
+    for (const CityLocation &loc : std::as_const(changed)) {
+        query.bindValue(":id", loc.cityId);
+        query.bindValue(":name", loc.name);
+        query.bindValue(":path", loc.path);
+        query.bindValue(":country", loc.country);
+        // 没有坐标存 NULL
+        query.bindValue(":lat", loc.hasCoordinates() ? QVariant(loc.lat) : QVariant());
+        query.bindValue(":lon", loc.hasCoordinates() ? QVariant(loc.lon) : QVariant());
+        if (!query.exec()) {
+            qDebug() << "保存城市位置失败:" << loc.cityId << query.lastError();
+            m_db.rollback();
+            return false;
+        }
+    }
+    if (!commitTransaction()) return false;
+
+    for (const CityLocation &loc : std::as_const(changed)) {
+        m_cityLocations.insert(loc);
+    }
+    return true;
+}
+
+QStringList DBManager::citiesWithHistory() const
+{
+    QStringList ids(m_citiesWithHistory.constBegin(), m_citiesWithHistory.constEnd());
+    ids.sort();
+    return ids;
+}
+
+bool DBManager::saveCityLocation(const QString &cityId, const TodayWeather &weather)
+{
+    CityLocation loc;
+    loc.cityId = cityId;
+    loc.name = weather.city;
+    loc.path = weather.path;
+    loc.country = weather.country;
+    return saveCityLocations({ loc });
+}
+
+QVector<CityDistance> DBManager::nearestCities(const QString &cityId, int n, bool withHistoryOnly) const
+{
+    const CityLocation *loc = m_cityLocations.find(cityId);
+    if (!loc || !loc->hasCoordinates()) return QVector<CityDistance>();
+
+    return m_cityLocations.nearest(loc->lat, loc->lon, n, [&](const QString &id) {
+        return id != cityId && (!withHistoryOnly || m_citiesWithHistory.contains(id));
+    });
+}
+
+QVector<CityDistance> DBManager::nearestCities(double lat, double lon, int n, bool withHistoryOnly) const
+{
+    return m_cityLocations.nearest(lat, lon, n, [&](const QString &id) {
+        return !withHistoryOnly || m_citiesWithHistory.contains(id);
+    });
+}
+
+QList<RegionMonth> DBManager::getRegionMonthly(const QString &region, int fromMonth, int toMonth)
+{
+    QList<RegionMonth> list;
+    if (!m_db.isOpen() && !initDB()) return list;
+
+    QSqlQuery query;
+    query.prepare("SELECT month, cities, days, avg_high, avg_low, max_high, min_low "
+                  "FROM RegionMonthly WHERE region = :region AND month BETWEEN :from AND :to "
+                  "ORDER BY month ASC");
+    query.bindValue(":region", region);
+    query.bindValue(":from", fromMonth);
+    query.bindValue(":to", toMonth);
+
+    if (!query.exec()) {
+        qDebug() << "查询区域汇总失败:" << query.lastError();
+        return list;
+    }
+    while (query.next()) {
+        RegionMonth m;
+        m.region = region;
+        m.month = query.value(0).toInt();
+        m.cities = query.value(1).toInt();
+        m.days = query.value(2).toInt();
+        m.avgHigh = query.value(3).toDouble();
+        m.avgLow = query.value(4).toDouble();
+        m.maxHigh = query.value(5).toInt();
+        m.minLow = query.value(6).toInt();
+        list.append(m);
+    }
+    return list;
+}
+
+int DBManager::refreshRegionRollup()
+{
+    if (!m_db.isOpen()) return -1;
+
+    // 平时只有上个月和本月的逐日数据还会变；区划变过就全部重算
+    const bool full = m_regionRollupDirty;
+    const QDate today = QDate::currentDate();
+    const QDate from = full ? QDate(1900, 1, 1) : QDate(today.year(), today.month(), 1).addMonths(-1);
+    const int fromMonth = from.year() * 100 + from.month();
+
+    // (区域, 月份) -> 累加值；平均值按天加权，所以累加的是总和
+    struct Acc {
+        double sumHigh = 0;
+        double sumLow = 0;
+        int days = 0;
+        int cities = 0;
+        int maxHigh = 0;
+        int minLow = 0;
+    };
+    QHash<QPair<QString, int>, Acc> acc;
+    QHash<QString, QStringList> regionCache;   // 城市 -> 上级区域
+
+    auto add = [&](const QString &cityId, int month, double sumHigh, double sumLow,
+                   int days, int maxHigh, int minLow) {
+        auto cached = regionCache.find(cityId);
+        if (cached == regionCache.end()) {
+            const CityLocation *loc = m_cityLocations.find(cityId);
+            cached = regionCache.insert(cityId, loc ? CitySpatialIndex::regionsOf(loc->path) : QStringList());
+        }
+        for (const QString &region : std::as_const(cached.value())) {
+            Acc &a = acc[qMakePair(region, month)];
+            if (a.days == 0) {
+                a.maxHigh = maxHigh;
+                a.minLow = minLow;
+            } else {
+                a.maxHigh = qMax(a.maxHigh, maxHigh);
+                a.minLow = qMin(a.minLow, minLow);
+            }
+            a.sumHigh += sumHigh;
+            a.sumLow += sumLow;
+            a.days += days;
+            a.cities++;   // 同一城市同一个月只会出现一行 (逐日分表和月度表的年份不重叠)
+        }
+    };
+
+    QSqlQuery query;
+
+    // 1. 保留期内的逐日数据：先在 SQLite 里按 (城市, 月) 汇总，只统计到今天 (历史表里也有未来几天的预报)
+    for (int year : std::as_const(m_historyYears)) {
+        if (year < from.year()) continue;
+
+        query.prepare(QString("SELECT city_id, CAST(strftime('%Y%m', day) AS INTEGER), "
+                              "SUM(high), SUM(low), COUNT(*), MAX(high), MIN(low) "
+                              "FROM %1 WHERE day BETWEEN :from AND :to GROUP BY 1, 2")
+                          .arg(historyPartition(year)));
+        query.bindValue(":from", from.toJulianDay());
+        query.bindValue(":to", today.toJulianDay());
+        if (!query.exec()) {
+            qDebug() << "区域汇总读取历史失败:" << year << query.lastError();
+            return -1;
+        }
+        while (query.next()) {
+            add(query.value(0).toString(), query.value(1).toInt(), query.value(2).toDouble(),
+                query.value(3).toDouble(), query.value(4).toInt(), query.value(5).toInt(),
+                query.value(6).toInt());
+        }
+    }
+
+    // 2. 已压缩的年份：直接用月度汇总
+    query.prepare("SELECT city_id, month, avg_high * days, avg_low * days, days, max_high, min_low "
+                  "FROM WeatherHistoryMonthly WHERE month >= :from");
+    query.bindValue(":from", fromMonth);
+    if (!query.exec()) {
+        qDebug() << "区域汇总读取月度表失败:" << query.lastError();
+        return -1;
+    }
+    while (query.next()) {
+        add(query.value(0).toString(), query.value(1).toInt(), query.value(2).toDouble(),
+            query.value(3).toDouble(), query.value(4).toInt(), query.value(5).toInt(),
+            query.value(6).toInt());
+    }
+
+    // 3. 替换 fromMonth 之后的汇总 (一个事务)
+    m_db.transaction();
+    query.prepare("DELETE FROM RegionMonthly WHERE month >= :from");
+    query.bindValue(":from", fromMonth);
+    if (!query.exec()) {
+        qDebug() << "区域汇总清理失败:" << query.lastError();
+        m_db.rollback();
+        return -1;
+    }
+
+    query.prepare("INSERT INTO RegionMonthly "
+                  "(region, month, cities, days, avg_high, avg_low, max_high, min_low) "
+                  "VALUES (:region, :month, :cities, :days, :avgHigh, :avgLow, :maxHigh, :minLow)");
+    for (auto it = acc.constBegin(); it != acc.constEnd(); ++it) {
+        const Acc &a = it.value();
+        if (a.days == 0) continue;
+        query.bindValue(":region", it.key().first);
+        query.bindValue(":month", it.key().second);
+        query.bindValue(":cities", a.cities);
+        query.bindValue(":days", a.days);
+        query.bindValue(":avgHigh", a.sumHigh / a.days);
+        query.bindValue(":avgLow", a.sumLow / a.days);
+        query.bindValue(":maxHigh", a.maxHigh);
+        query.bindValue(":minLow", a.minLow);
+        if (!query.exec()) {
+            qDebug() << "写入区域汇总失败:" << query.lastError();
+            m_db.rollback();
+            return -1;
+        }
+    }
+    if (!commitTransaction()) return -1;
+
+    m_regionRollupDirty = false;
+    qDebug() << "区域汇总已更新:" << acc.size() << "行" << (full ? "(全部重算)" : "");
+    return acc.size();
+}
@@ -8,7 +8,22 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QCoreApplication>
+#include <QHash>
+#include <QPair>
+#include <QTimer>
+#include <QDate>
+#include <QSet>
 #include "weatherdata.h"
+#include "cityspatialindex.h"
+
+// 【新增】历史表写入统计：看看有多少次写入被省掉了
+struct HistoryWriteStats {
+    quint64 requested = 0;        // 调用方请求写入的天数
+    quint64 skippedByDigest = 0;  // 内存摘要判断未变化，直接跳过，没碰 SQLite
+    quint64 skippedBySqlite = 0;  // 执行了 UPSERT，但 WHERE 条件不满足，SQLite 没写
+    quint64 skippedExpired = 0;   // 日期早于保留期 (那一年已压缩成月度汇总)，丢弃
+    quint64 written = 0;          // 实际插入或更新的行数
+};
 
 class DBManager : public QObject
 {
@@ -20,6 +35,13 @@ public:
     // 初始化数据库 (连接 + 建表)
     bool initDB();
 
+    // 【新增】数据库文件路径 (可执行文件同级目录下的 weather.db)，不需要先 initDB
+    static QString databasePath();
+
+    // 【新增】把老库切换成增量 VACUUM (需要完整 VACUUM 一次，库大时很慢)
+    // 不在启动时自动做，由 --convert-vacuum 命令行显式执行
+    bool convertToIncrementalVacuum();
+
     // 保存/更新天气缓存
     // 参数: 城市ID, 城市名称, JSON原始字符串
     bool cacheWeather(const QString &cityId, const QString &cityName, const QByteArray &jsonData);
@@ -29,14 +51,81 @@ public:
     // 返回: 缓存的JSON数据 (如果不存在或过期，返回空字节数组)
     QByteArray getWeatherCache(const QString &cityId);
 
+    // 【新增】数据没变化时只刷新缓存时间，不重写 JSON
+    bool touchWeatherCache(const QString &cityId);
+
     // 【新增】插入单条历史天气数据
     // 返回 true 表示插入或更新成功
     bool insertHistoryData(const QString &cityId, const QString &date, int high, int low);
 
+    // 【新增】批量保存一个城市的预报 (一个事务)，只写真正变化了的天
+    // issueDate 是这份预报的发布日 (TodayWeather::issueDate)，为空时只写历史，不存档
+    // 返回实际写入的行数，出错返回 -1
+    int saveForecast(const QString &cityId, const QList<DayWeather> &forecast, const QDate &issueDate);
+
+    // 【新增】批量写入 JsonHelper::parseWeatherBatch 的结果 (所有城市一个事务)
+    // 预报存档用每个 payload 自己的发布日 (daily_update)，没有发布日的只写历史
+    // 返回实际写入的历史行数，出错返回 -1
+    int saveParsedBatch(const ParsedBatch &batch);
+
+    // 【新增】预报按发布日期保存 (城市, 目标日期, 提前天数, 高温, 低温)
+    // issueDate 为空时不存 (猜成今天会把旧缓存算成今天发布的预报)；saveForecast 会自动调用
+    bool saveForecastVintage(const QString &cityId, const QList<DayWeather> &forecast,
+                             const QDate &issueDate);
+
+    // 【新增】预报准确度：按提前天数统计 MAE 和偏差
+    QList<ForecastScore> getForecastScores(const QString &cityId);
+
+    // 【新增】写入统计
+    HistoryWriteStats historyWriteStats() const { return m_historyStats; }
+
+    // 【新增】逐日数据保留到的最早年份，更早的年份只有月度汇总，不再接受逐日写入
+    // (写入时直接丢弃，计入 HistoryWriteStats::skippedExpired)
+    int oldestKeptYear() const { return QDate::currentDate().year() - HISTORY_KEEP_YEARS; }
+
     // 【新增】查询某个城市的历史趋势（按日期排序）
     // 返回结构体列表，用于画图
     QList<DayWeather> getHistoryData(const QString &cityId);
 
+    // 【新增】查询某个城市 [from, to] 区间的历史，只扫描涉及到的年份分表
+    QList<DayWeather> getHistoryRange(const QString &cityId, const QDate &from, const QDate &to);
+
+    // 【新增】历史分表年份 (升序)，给读连接池在其他线程查询时用
+    QList<int> historyYears() const { return m_historyYears; }
+
+    // 【新增】在指定连接上按年份列表查询历史 (不碰 m_db，可以在任意线程用自己的连接调用)
+    static QList<DayWeather> queryHistoryRange(const QSqlDatabase &db, const QList<int> &years,
+                                               const QString &cityId, const QDate &from, const QDate &to);
+
+    // 【新增】查询已压缩的月度汇总 (超过保留期的年份)
+    QList<MonthWeather> getMonthlyHistory(const QString &cityId);
+
+    // 【新增】追加一条实况观测 (先进内存缓冲，攒够一批或过一会儿再一次性写入)
+    void appendObservation(const QString &cityId, const TodayWeather &weather);
+
+    // 【新增】查询某城市最近 hours 小时的观测 (按时间升序)
+    QList<NowObservation> getRecentObservations(const QString &cityId, int hours = 24);
+
+    // 【新增】保存城市位置 (行政区划 / 坐标)，空字段不覆盖已有值，内容没变不碰 SQLite
+    bool saveCityLocations(const QList<CityLocation> &locations);
+    bool saveCityLocation(const CityLocation &location) { return saveCityLocations({ location }); }
+    // 从解析好的天气里取行政区划 (接口不带坐标，坐标由城市字典提供)
+    bool saveCityLocation(const QString &cityId, const TodayWeather &weather);
+
+    // 【新增】有历史数据的城市 (批量导出等用)
+    QStringList citiesWithHistory() const;
+
+    // 【新增】城市位置索引 (内存)
+    const CitySpatialIndex &cityLocations() const { return m_cityLocations; }
+
+    // 【新增】离某城市最近的 n 个城市 (不含自己)，withHistoryOnly 时只返回有历史数据的城市
+    QVector<CityDistance> nearestCities(const QString &cityId, int n, bool withHistoryOnly = true) const;
+    QVector<CityDistance> nearestCities(double lat, double lon, int n, bool withHistoryOnly = true) const;
+
+    // 【新增】区域月度汇总 [fromMonth, toMonth] (yyyyMM)，区域写法见 CitySpatialIndex::regionsOf
+    // 读的是维护任务预先算好的 RegionMonthly，不扫逐日历史
+    QList<RegionMonth> getRegionMonthly(const QString &region, int fromMonth, int toMonth);
+
     // 【新增】获取数据库连接对象的接口
     QSqlDatabase getDatabase();
 
@@ -45,6 +134,25 @@ public:
     // 【新增】根据拼音ID获取中文城市名 (从缓存表中查)
     QString getCityName(const QString &cityId);
 
+public slots:
+    // 【新增】把缓冲区里的观测立即写入数据库
+    bool flushObservations();
+
+    // 【新增】定期维护：预报评分、旧年份压缩成月度汇总、清理过期缓存、增量 VACUUM
+    void runMaintenance();
+
+    // 【新增】把 WAL 里积压的内容写回主库 (不等读连接)；长时间的读事务 (在线备份) 结束后调用
+    // 数据库没打开 (例如单独的 --backup 进程) 时什么都不做，返回 false
+    bool checkpointWal();
+
+    // 【新增】增量评分：只处理还没评过 (scored = 0)、目标日期到昨天为止的存档，
+    // 实际值取该日实况观测的最高/最低温，返回新评分的样本数
+    int scoreForecasts();
+
+    // 【新增】重算区域月度汇总：平时只算上个月和本月，城市区划有变化后全部重算
+    // 返回写入的 (区域, 月份) 行数，出错返回 -1
+    int refreshRegionRollup();
+
 private:
     explicit DBManager(QObject *parent = nullptr);
     ~DBManager();
@@ -55,9 +163,70 @@ private:
 
     QSqlDatabase m_db;
 
+    // 【新增】提交事务；失败时回滚并返回 false (调用方负责把内存状态恢复成以库为准)
+    bool commitTransaction();
+
+    // 【新增】每个城市最近写入的 (日期 -> 高温/低温)，用来在碰 SQLite 之前判断是否变化
+    QHash<QString, QHash<qint64, QPair<int, int>>> m_historyDigest;  // 城市 -> (儒略日 -> 高/低)
+    HistoryWriteStats m_historyStats;
+
+    // 真正执行 UPSERT，返回 -1 失败 / 0 未变化 / 1 已写入
+    int upsertHistory(const QString &cityId, const QDate &day, int high, int low);
+    // 摘要判断 + UPSERT
+    bool insertHistoryDay(const QString &cityId, const QDate &day, int high, int low);
+    // 摘要只保留当前预报窗口 (今天及以后)，更早的日期不会再被预报改写
+    void pruneHistoryDigest(const QString &cityId);
+
+    // 【新增】历史按年分表，m_historyYears 是已存在的年份 (升序)
+    QList<int> m_historyYears;
+    static QString historyPartition(int year);
+    static DayWeather dayFromRow(const QSqlQuery &query);
+    bool loadHistoryPartitions();
+    bool createHistoryPartition(int year);   // 只建表
+    bool ensureHistoryPartition(int year);   // 建表 + 重建视图
+    bool rebuildHistoryView();
+    bool migrateLegacyHistory();
+
+    // 【新增】每个城市最近一次写入的预报批次 (发布日 + 各天数值)，没变就不碰 SQLite
+    QHash<QString, QString> m_vintageDigest;
+
+    // 【新增】城市位置索引 + 有历史数据的城市
+    CitySpatialIndex m_cityLocations;
+    QSet<QString> m_citiesWithHistory;
+    bool m_regionRollupDirty = false;   // 有城市的区划变了，下次汇总要全部重算
+    bool loadCityLocations();
+
+    // 【新增】观测日志写缓冲
+    QList<QPair<QString, NowObservation>> m_pendingObservations;
+    QTimer *m_observationFlushTimer = nullptr;
+
+    // 【新增】保留策略
+    int compactOldHistory();
+    bool migrateForecastScoring();
+    int evictStaleCache();
+    QTimer *m_maintenanceTimer = nullptr;
+
     // 设置缓存过期时间 (例如 1 小时 = 3600 秒)
     const int CACHE_EXPIRE_SECONDS = 3600;
 
+    // 【新增】逐日历史保留年数 (今年 + 往前 2 年)，更早的压缩成月度汇总
+    const int HISTORY_KEEP_YEARS = 2;
+    // 【新增】缓存行超过 7 天没更新就删掉
+    const int CACHE_RETENTION_DAYS = 7;
+    // 【新增】每次维护最多回收的空闲页数
+    const int INCREMENTAL_VACUUM_PAGES = 256;
+    // 【新增】观测缓冲满多少条立即写入 / 最多缓冲多久
+    const int OBSERVATION_BATCH_SIZE = 200;
+    const int OBSERVATION_FLUSH_MS = 2000;
+    // 【新增】一天至少有几条观测才把它们的最高/最低温当作实际值
+    const int SCORE_MIN_OBSERVATIONS = 6;
+    // 【新增】目标日期过去这么多天还没有实际值，就不再等了
+    const int SCORE_GRACE_DAYS = 3;
+    // 【新增】WAL 文件重置后保留的最大字节数 (64 MB)
+    const qint64 WAL_SIZE_LIMIT_BYTES = 64 * 1024 * 1024;
+    // 【新增】维护间隔 (1 小时)
+    const int MAINTENANCE_INTERVAL_MS = 60 * 60 * 1000;
+
 
 };
 
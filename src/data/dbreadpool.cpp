@@ -0,0 +1,121 @@
+#include "dbreadpool.h"
+#include "dbmanager.h"
+#include <QThread>
+#include <QThreadStorage>
+#include <QSemaphore>
+#include <QMutex>
+#include <QSqlError>
+#include <QDebug>
+
+namespace {
+
+// 线程结束时 QThreadStorage 会删除它，顺便关闭并移除这个线程的连接
+struct ThreadConnection {
+    QString name;
+
+    ~ThreadConnection()
+    {
+        {
+            QSqlDatabase db = QSqlDatabase::database(name, false);
+            if (db.isOpen()) db.close();
+        }
+        QSqlDatabase::removeDatabase(name);
+    }
+};
+
+QThreadStorage<ThreadConnection*> g_threadConnection;
+
+} // namespace
+
+DBReadPool &DBReadPool::getInstance()
+{
+    static DBReadPool instance;
+    return instance;
+}
+
+DBReadPool::DBReadPool()
+{
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+DBReadPool::~DBReadPool()
+{
+    m_pool.waitForDone();
+}
+
+QSqlDatabase DBReadPool::connectionForCurrentThread()
+{
+    if (g_threadConnection.hasLocalData()) {
+        return QSqlDatabase::database(g_threadConnection.localData()->name);
+    }
+    if (m_dbPath.isEmpty()) {
+        qDebug() << "只读连接: 还没有设置数据库路径";
+        return QSqlDatabase();
+    }
+
+    // 连接名带上线程地址，保证每个线程一个
+    const QString name = QString("weather_read_%1")
+                             .arg(reinterpret_cast<quintptr>(QThread::currentThread()), 0, 16);
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+    db.setDatabaseName(m_dbPath);
+    // 只读 + 遇到写锁时等一会儿而不是立即报错
+    db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+    if (!db.open()) {
+        qDebug() << "只读连接打开失败:" << db.lastError();
+    }
+
+    ThreadConnection *holder = new ThreadConnection;
+    holder->name = name;
+    g_threadConnection.setLocalData(holder);
+    return db;
+}
+
+QHash<QString, QList<DayWeather>> DBReadPool::getHistoryForCities(const QStringList &cityIds)
+{
+    const QList<int> years = DBManager::getInstance().historyYears();
+    if (years.isEmpty()) return QHash<QString, QList<DayWeather>>();
+
+    return getHistoryForCities(cityIds, QDate(years.first(), 1, 1), QDate(years.last(), 12, 31));
+}
+
+QHash<QString, QList<DayWeather>> DBReadPool::getHistoryForCities(const QStringList &cityIds,
+                                                                  const QDate &from, const QDate &to)
+{
+    QHash<QString, QList<DayWeather>> result;
+    if (cityIds.isEmpty()) return result;
+
+    // 分表年份在调用线程里取一份快照，工作线程不碰 DBManager 的成员
+    const QList<int> years = DBManager::getInstance().historyYears();
+
+    // 按线程数切块，每块一个任务，块内复用同一个连接
+    const int chunks = qMin(cityIds.size(), qMax(1, m_pool.maxThreadCount()));
+    const int perChunk = (cityIds.size() + chunks - 1) / chunks;
+
+    QMutex mutex;
+    QSemaphore done;
+    int started = 0;
+
+    for (int begin = 0; begin < cityIds.size(); begin += perChunk) {
+        const QStringList chunk = cityIds.mid(begin, perChunk);
+        ++started;
+
+        m_pool.start([this, chunk, years, from, to, &result, &mutex, &done]() {
+            QSqlDatabase db = connectionForCurrentThread();
+
+            // 先查到局部结果里，最后只加一次锁合并
+            QHash<QString, QList<DayWeather>> local;
+            for (const QString &cityId : chunk) {
+                local.insert(cityId, DBManager::queryHistoryRange(db, years, cityId, from, to));
+            }
+            {
+                QMutexLocker locker(&mutex);
+                result.insert(local);
+            }
+            done.release();
+        });
+    }
+
+    done.acquire(started);
+    return result;
+}
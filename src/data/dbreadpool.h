@@ -0,0 +1,52 @@
+#ifndef DBREADPOOL_H
+#define DBREADPOOL_H
+
+#include <QSqlDatabase>
+#include <QThreadPool>
+#include <QHash>
+#include <QDate>
+#include <QStringList>
+#include "weatherdata.h"
+
+/**
+ * @brief 只读连接池 + 并行查询
+ * DBManager 的连接只能在主线程用，而且读写共用一个连接。这里给每个工作线程单独开一个
+ * 只读 SQLite 连接 (数据库开启了 WAL，读不会挡写)，多城市的历史查询拆到线程池里并行跑，
+ * 最后合并结果。
+ *
+ * 注意：数据库路径要先在主线程设置好 (DBManager::initDB() 会调用 setDatabasePath())，
+ * 工作线程只读这份拷贝，不碰 DBManager；按年份查询还要求 initDB() 过 (要用分表年份)。
+ */
+class DBReadPool
+{
+public:
+    static DBReadPool& getInstance();
+
+    // 只读连接打开的数据库文件，必须在启动任何查询之前 (主线程) 设置
+    void setDatabasePath(const QString &path) { m_dbPath = path; }
+
+    // 当前线程专用的只读连接 (第一次调用时创建，线程结束时自动关闭)
+    QSqlDatabase connectionForCurrentThread();
+
+    // 并行查询多个城市 [from, to] 的历史，返回 城市ID -> 按日期升序的列表
+    // 会阻塞直到全部查完 (不要在持有写事务时调用)
+    QHash<QString, QList<DayWeather>> getHistoryForCities(const QStringList &cityIds,
+                                                          const QDate &from, const QDate &to);
+
+    // 全部年份
+    QHash<QString, QList<DayWeather>> getHistoryForCities(const QStringList &cityIds);
+
+    void setMaxThreads(int count) { m_pool.setMaxThreadCount(count); }
+
+private:
+    DBReadPool();
+    ~DBReadPool();
+
+    DBReadPool(const DBReadPool&) = delete;
+    DBReadPool& operator=(const DBReadPool&) = delete;
+
+    QThreadPool m_pool;
+    QString m_dbPath;   // 设置后只读，工作线程可以直接用
+};
+
+#endif // DBREADPOOL_H
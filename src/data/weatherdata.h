@@ -3,6 +3,11 @@
 
 #include <QString>
 #include <QList>
+#include <QStringList>
+#include <QVector>
+#include <QByteArray>
+#include <QDate>
+#include <QtNumeric>
 
 /**
  * @brief 单日天气数据结构体
@@ -30,6 +35,10 @@ struct TodayWeather {
     QString city;       // 城市名
     QString cityId;     // 城市ID
     QString date;       // 发布日期
+    QString updateTime; // 实况观测时间 (ISO 格式，例如 "2026-01-05T14:20:00+08:00")
+    QDate issueDate;    // 【新增】预报发布日 (取自预报接口的 last_update，即 daily_update)，没有时为空
+    QString path;       // 【新增】行政区划路径 (例如 "海淀,北京,北京,中国")，由小到大
+    QString country;    // 【新增】国家代码 (例如 "CN")
 
     QString wendu;      // 实时温度
     QString shidu;      // 湿度
@@ -43,4 +52,109 @@ struct TodayWeather {
     QList<DayWeather> forecast;
 };
 
+/**
+ * @brief 实况观测记录
+ * 每次拉到的 "now" 数据都追加一条，用于画 24 小时走势
+ */
+struct NowObservation {
+    qint64 time;        // 观测时间 (Unix 秒)
+    int temp;           // 温度
+    int humidity;       // 湿度
+    QString text;       // 天气现象 (例如 "晴")
+};
+
+/**
+ * @brief 预报准确度 (某城市、某提前天数)
+ * 误差 = 预报值 - 实际值 (该日实况观测的最高/最低温)，bias > 0 表示预报偏高
+ */
+struct ForecastScore {
+    int lead;           // 提前天数 (0 = 当天发布，1 = 提前一天的预报)
+    int samples;        // 参与统计的天数
+    double maeHigh;     // 最高温平均绝对误差
+    double biasHigh;    // 最高温平均偏差
+    double maeLow;      // 最低温平均绝对误差
+    double biasLow;     // 最低温平均偏差
+};
+
+/**
+ * @brief 批量解析的输入：一个城市的原始 JSON (WeatherManager 合并后的格式)
+ */
+struct RawPayload {
+    QString cityId;
+    QByteArray json;
+};
+
+/**
+ * @brief 紧凑的单日预报 (8 字节)，批量解析/批量写库用
+ */
+struct CompactDay {
+    qint32 julianDay;   // 儒略日
+    qint16 high;
+    qint16 low;
+};
+
+/**
+ * @brief 批量解析结果
+ * 所有城市的预报连续放在 days 里，第 i 个城市是 [dayOffsets[i], dayOffsets[i+1])
+ */
+struct ParsedBatch {
+    QStringList cityIds;
+    QStringList cityNames;
+    QVector<bool> ok;           // 第 i 个 payload 是否解析成功
+    QVector<qint32> issueDays;  // 第 i 个 payload 的发布日 (儒略日，取自 daily_update)，0 = 未知
+    QVector<int> dayOffsets;    // 长度 = 城市数 + 1
+    QVector<CompactDay> days;
+};
+
+/**
+ * @brief 月度汇总数据结构体
+ * 超过保留期的逐日历史会被压缩成这种形式
+ */
+struct MonthWeather {
+    int month;          // 月份 (yyyyMM，例如 202401)
+    double avgHigh;     // 月平均最高温
+    double avgLow;      // 月平均最低温
+    int maxHigh;        // 月内最高温
+    int minLow;         // 月内最低温
+    int days;           // 参与统计的天数
+};
+
+/**
+ * @brief 城市位置 (坐标 + 行政区划)
+ * 行政区划取自心知天气 location.path；坐标取自城市字典，没有时为 NaN
+ */
+struct CityLocation {
+    QString cityId;     // 与缓存表/历史表相同的城市ID (拼音)
+    QString name;       // 中文名
+    QString path;       // 行政区划路径，由小到大，逗号分隔
+    QString country;    // 国家代码
+    double lat = qQNaN();
+    double lon = qQNaN();
+
+    bool hasCoordinates() const { return !qIsNaN(lat) && !qIsNaN(lon); }
+};
+
+/**
+ * @brief 就近查询结果
+ */
+struct CityDistance {
+    QString cityId;
+    double km;          // 球面距离 (公里)
+};
+
+/**
+ * @brief 区域月度汇总 (省 / 国家等)
+ * 区域 = 城市行政区划路径的后缀，例如 "北京,中国"、"中国"
+ */
+struct RegionMonth {
+    QString region;
+    int month;          // yyyyMM
+    int cities;         // 有数据的城市数
+    int days;           // 城市·天 样本数
+    double avgHigh;     // 平均最高温 (按天加权)
+    double avgLow;      // 平均最低温
+    int maxHigh;        // 区域内最高温
+    int minLow;         // 区域内最低温
+};
+
 #endif // WEATHERDATA_H
@@ -1,9 +1,23 @@
 #include "weathermanager.h"
+#include <QCoreApplication>
+#include <QPromise>
+#include <QTimer>
+#include <QUrlQuery>
+#include <memory>
+#include <utility>
 
 WeatherManager::WeatherManager(QObject *parent)
     : QObject{parent}
 {
     m_manager = new QNetworkAccessManager(this);
+
+    // 【新增】HTTP 磁盘缓存：按服务器的 ETag / Last-Modified / Cache-Control 缓存响应，
+    // 再次请求时 QNetworkAccessManager 会自动带上 If-None-Match / If-Modified-Since，
+    // 服务器回 304 时直接用缓存内容，不再下载正文
+    QNetworkDiskCache *diskCache = new QNetworkDiskCache(this);
+    diskCache->setCacheDirectory(QCoreApplication::applicationDirPath() + "/http_cache");
+    diskCache->setMaximumCacheSize(HTTP_CACHE_MAX_BYTES);
+    m_manager->setCache(diskCache);
 }
 
 WeatherManager::~WeatherManager()
@@ -11,116 +25,268 @@ WeatherManager::~WeatherManager()
     // 自动销毁
 }
 
-void WeatherManager::getWeather(const QString &cityId)
+QNetworkRequest WeatherManager::makeRequest(const QString &urlStr) const
 {
-    m_currentCityId = cityId;
-    requestNowWeather();
+    QUrl url(urlStr);            // 1. 先把字符串转成 URL 对象
+    QNetworkRequest request(url); // 2. 再把 URL 放进 Request
+
+    // 优先走网络，但有缓存时发条件请求 (304 则复用缓存)
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, true);
+
+    // 压缩传输：QNetworkAccessManager 默认就会发送 Accept-Encoding 并自动解压，
+    // 注意不要手动设置 Accept-Encoding 头，否则 Qt 会关掉自动解压
+    return request;
 }
 
-// --- 阶段一：获取实况天气 (Now) ---
-void WeatherManager::requestNowWeather()
+QString WeatherManager::apiUrl(const QString &path, const QString &cityId,
+                               const QList<QPair<QString, QString>> &extra) const
 {
-    // 心知天气实况接口
-    // 参数: key, location, language=zh-Hans(简体中文), unit=c(摄氏度)
-    QString urlStr = QString("%1/v3/weather/now.json?key=%2&location=%3&language=zh-Hans&unit=c")
-                         .arg(API_HOST, API_KEY, m_currentCityId);
+    QUrlQuery query;
+    query.addQueryItem("key", API_KEY);
+    query.addQueryItem("location", cityId);
+    query.addQueryItem("language", "zh-Hans");
+    query.addQueryItem("unit", "c");
+    for (const auto &item : extra) query.addQueryItem(item.first, item.second);
 
-    // 修改后：
-    QUrl url(urlStr);            // 1. 先把字符串转成 URL 对象
-    QNetworkRequest request(url); // 2. 再把 URL 放进 Request
-    QNetworkReply *reply = m_manager->get(request);
+    QUrl url(API_HOST + path);
+    url.setQuery(query);
+    return url.toString(QUrl::FullyEncoded);
+}
 
-    connect(reply, &QNetworkReply::finished, this, [=]() {
-        if (reply->error() == QNetworkReply::NoError) {
-            QByteArray data = reply->readAll();
-
-            QJsonDocument doc = QJsonDocument::fromJson(data);
-
-            // 【心知天气校验逻辑】检查是否有 "results" 数组
-            if (doc.isObject() && doc.object().contains("results")) {
-                QJsonArray results = doc.object()["results"].toArray();
-                if (!results.isEmpty()) {
-                    // 暂存结果中的第一个对象 (包含 location 和 now)
-                    m_tempNowData = results[0].toObject();
-
-                    // -> 进入下一阶段：查未来天气
-                    requestDailyWeather();
-                } else {
-                    emit errorOccurred("API Error: Empty results");
-                }
-            } else {
-                emit errorOccurred("API Error: Invalid format");
-            }
-        } else {
-            emit errorOccurred("Network Error (Now): " + reply->errorString());
+namespace {
+
+// 两个 QFuture 都完成后给出二者结果；任何一个失败，整体就以它的异常失败
+template <typename A, typename B>
+QFuture<std::pair<A, B>> whenBoth(QObject *context, QFuture<A> first, QFuture<B> second)
+{
+    struct State {
+        QPromise<std::pair<A, B>> promise;
+        std::pair<A, B> value;
+        int remaining = 2;
+        bool failed = false;
+    };
+    auto state = std::make_shared<State>();
+    state->promise.start();
+
+    auto step = [state]() {
+        if (--state->remaining == 0 && !state->failed) {
+            state->promise.addResult(state->value);
+            state->promise.finish();
         }
-        reply->deleteLater();
-    });
+    };
+    auto fail = [state](const FetchError &e) {
+        if (state->failed) return;
+        state->failed = true;
+        state->promise.setException(e);
+        state->promise.finish();
+    };
+
+    first.then(context, [state, step](const A &a) { state->value.first = a; step(); })
+         .onFailed(context, fail);
+    second.then(context, [state, step](const B &b) { state->value.second = b; step(); })
+          .onFailed(context, fail);
+
+    return state->promise.future();
 }
 
-// --- 阶段二：获取逐日预报 (Daily) 并合并 ---
-void WeatherManager::requestDailyWeather()
+} // namespace
+
+void WeatherManager::getWeather(const QString &cityId)
 {
-    // 心知天气预报接口 (免费版通常支持 3 天)
-    // start=0 (从今天开始), days=3 (查3天)
-    QString urlStr = QString("%1/v3/weather/daily.json?key=%2&location=%3&language=zh-Hans&unit=c&start=0&days=3")
-                         .arg(API_HOST, API_KEY, m_currentCityId);
+    // 新的搜索取代旧的：旧请求直接中止，不会再把过期城市的数据发出去
+    cancel();
 
-    // 修改后：
-    QUrl url(urlStr);            // 1. 先把字符串转成 URL 对象
-    QNetworkRequest request(url); // 2. 再把 URL 放进 Request
-    QNetworkReply *reply = m_manager->get(request);
+    auto ctx = QSharedPointer<FetchContext>::create();
+    ctx->cityId = cityId;
+    m_current = ctx;
+    startFetch(ctx);
+}
 
-    connect(reply, &QNetworkReply::finished, this, [=]() {
-        if (reply->error() == QNetworkReply::NoError) {
-            QByteArray data = reply->readAll();
-            QJsonDocument doc = QJsonDocument::fromJson(data);
+void WeatherManager::fetchWeather(const QString &cityId)
+{
+    if (m_parallel.contains(cityId)) return;
 
-            if (doc.isObject() && doc.object().contains("results")) {
-                QJsonArray results = doc.object()["results"].toArray();
+    auto ctx = QSharedPointer<FetchContext>::create();
+    ctx->cityId = cityId;
+    m_parallel.insert(cityId, ctx);
+    startFetch(ctx);
+}
 
-                if (!results.isEmpty()) {
-                    QJsonObject dailyData = results[0].toObject();
+void WeatherManager::releaseContext(const QSharedPointer<FetchContext> &ctx)
+{
+    if (m_current == ctx) m_current.reset();
+    auto it = m_parallel.find(ctx->cityId);
+    if (it != m_parallel.end() && it.value() == ctx) m_parallel.erase(it);
+}
 
-                    // 【数据合并】
-                    // 我们构建一个统一的 JSON 结构传给 UI 和 数据库
-                    // 结构:
-                    // {
-                    //    "location": {城市信息},
-                    //    "now": {实况温度},
-                    //    "daily": [预报列表]
-                    // }
+void WeatherManager::startFetch(const QSharedPointer<FetchContext> &ctx)
+{
+    // 总时限：两个请求加起来超过 FETCH_BUDGET_MS 就中止 (单个请求还有自己的传输超时)
+    QWeakPointer<FetchContext> weak = ctx;
+    QTimer::singleShot(FETCH_BUDGET_MS, this, [this, weak]() {
+        if (QSharedPointer<FetchContext> c = weak.toStrongRef())
+            abortContext(c, true);
+    });
 
-                    QJsonObject finalObj;
+    // 实况 (Now) 和逐日预报 (Daily) 互不依赖，同时发出，都回来后再合并
+    // 参数: key, location, language=zh-Hans(简体中文), unit=c(摄氏度)
+    // 预报 start=0 (从今天开始), days=3 (免费版通常支持 3 天)
+    QString nowUrl = apiUrl("/v3/weather/now.json", ctx->cityId);
+    QString dailyUrl = apiUrl("/v3/weather/daily.json", ctx->cityId, { { "start", "0" }, { "days", "3" } });
 
-                    // 1. 放入位置信息 (从实况数据里取)
-                    if(m_tempNowData.contains("location"))
-                        finalObj["location"] = m_tempNowData["location"];
+    whenBoth(this, fetchResult(ctx, nowUrl, "Now"), fetchResult(ctx, dailyUrl, "Daily"))
+        .then(this, [this, ctx](const std::pair<QJsonObject, QJsonObject> &results) {
+            finishFetch(ctx, results.first, results.second);
+        })
+        .onFailed(this, [this, ctx](const FetchError &e) {
+            releaseContext(ctx);
+            // 被取代的请求静默结束；超时和网络错误照常上报
+            if (!e.cancelled) {
+                emit errorOccurred(e.message);
+                emit fetchFailed(ctx->cityId, e.message);
+            }
+        });
+}
 
-                    // 2. 放入实况 (now)
-                    if(m_tempNowData.contains("now"))
-                        finalObj["now"] = m_tempNowData["now"];
+void WeatherManager::cancel()
+{
+    if (m_current) {
+        abortContext(m_current, false);
+        m_current.reset();
+    }
+}
 
-                    // 3. 放入预报 (daily)
-                    if(dailyData.contains("daily"))
-                        finalObj["daily"] = dailyData["daily"];
+void WeatherManager::abortContext(const QSharedPointer<FetchContext> &ctx, bool timedOut)
+{
+    if (ctx->cancelled || ctx->timedOut) return;
+    if (timedOut) ctx->timedOut = true;
+    else ctx->cancelled = true;
 
-                    // 转为字符串发送
-                    QJsonDocument finalDoc(finalObj);
-                    QByteArray finalBytes = finalDoc.toJson(QJsonDocument::Compact);
+    // abort() 会同步触发 finished，fetchResult 里按上面的标记给出失败原因
+    const QList<QPointer<QNetworkReply>> replies = ctx->replies;
+    for (const QPointer<QNetworkReply> &reply : replies) {
+        if (reply && reply->isRunning()) reply->abort();
+    }
+}
 
-                    qDebug() << "Data Fetch Success. Size:" << finalBytes.size();
-                    emit weatherReceived(m_currentCityId, finalBytes);
+// --- 单个请求：取 results[0]，失败 / 超时 / 取消都以 FetchError 结束 ---
+QFuture<QJsonObject> WeatherManager::fetchResult(const QSharedPointer<FetchContext> &ctx,
+                                                 const QString &urlStr, const QString &stage)
+{
+    auto promise = std::make_shared<QPromise<QJsonObject>>();
+    promise->start();
 
-                } else {
-                    emit errorOccurred("API Error: Empty daily results");
-                }
-            } else {
-                emit errorOccurred("API Error: Invalid daily format");
-            }
-        } else {
-            emit errorOccurred("Network Error (Daily): " + reply->errorString());
-        }
+    QNetworkRequest request = makeRequest(urlStr);
+    // 传输超时：连接或收数据卡住超过这个时间，Qt 自动中止并报 OperationCanceledError
+    request.setTransferTimeout(TRANSFER_TIMEOUT_MS);
+
+    QNetworkReply *reply = m_manager->get(request);
+    ctx->replies.append(reply);
+
+    connect(reply, &QNetworkReply::finished, this, [this, ctx, reply, promise, stage]() {
         reply->deleteLater();
+        ctx->replies.removeAll(reply);
+
+        auto fail = [this, &ctx, &promise](const FetchError &e) {
+            promise->setException(e);
+            promise->finish();
+            // 这一路真的失败了，整次请求已经注定失败：另一路不用再等，静默中止
+            // (先报出本路的错误，whenBoth 只认第一个失败，不会被后面的 "取消" 盖掉)
+            if (!e.cancelled) abortContext(ctx, false);
+        };
+
+        if (ctx->cancelled) {
+            fail(FetchError("Cancelled (" + stage + "): " + ctx->cityId, true));
+            return;
+        }
+        if (ctx->timedOut) {
+            fail(FetchError("Timeout (" + stage + "): " + ctx->cityId));
+            return;
+        }
+        if (reply->error() != QNetworkReply::NoError) {
+            fail(FetchError("Network Error (" + stage + "): " + reply->errorString()));
+            return;
+        }
+
+        if (reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()) {
+            qDebug() << stage << ": 304 / 命中 HTTP 缓存";
+        }
+
+        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
+
+        // 【心知天气校验逻辑】检查是否有 "results" 数组
+        if (!doc.isObject() || !doc.object().contains("results")) {
+            fail(FetchError("API Error: Invalid " + stage + " format"));
+            return;
+        }
+        QJsonArray results = doc.object()["results"].toArray();
+        if (results.isEmpty()) {
+            fail(FetchError("API Error: Empty " + stage + " results"));
+            return;
+        }
+
+        // 结果中的第一个对象 (包含 location 和 now / daily)
+        promise->addResult(results[0].toObject());
+        promise->finish();
     });
+
+    return promise->future();
+}
+
+// --- 合并实况和预报，发给下游 ---
+void WeatherManager::finishFetch(const QSharedPointer<FetchContext> &ctx,
+                                 const QJsonObject &nowData, const QJsonObject &dailyData)
+{
+    releaseContext(ctx);
+    const QString &cityId = ctx->cityId;
+
+    // 【数据合并】
+    // 我们构建一个统一的 JSON 结构传给 UI 和 数据库
+    // 结构:
+    // {
+    //    "location": {城市信息},
+    //    "now": {实况温度},
+    //    "last_update": 实况观测时间,
+    //    "daily": [预报列表],
+    //    "daily_update": 预报发布时间
+    // }
+
+    QJsonObject finalObj;
+
+    // 1. 放入位置信息 (从实况数据里取)
+    if(nowData.contains("location"))
+        finalObj["location"] = nowData["location"];
+
+    // 2. 放入实况 (now)
+    if(nowData.contains("now"))
+        finalObj["now"] = nowData["now"];
+
+    // 【新增】实况的观测时间，写观测日志时用
+    if(nowData.contains("last_update"))
+        finalObj["last_update"] = nowData["last_update"];
+
+    // 3. 放入预报 (daily)
+    if(dailyData.contains("daily"))
+        finalObj["daily"] = dailyData["daily"];
+
+    // 【新增】预报自己的发布时间：预报存档按它算提前天数 (不能用实况的观测时间，
+    // 零点前后或预报没及时更新时两者不是同一天)
+    if(dailyData.contains("last_update"))
+        finalObj["daily_update"] = dailyData["last_update"];
+
+    // 转为字符串发送
+    QJsonDocument finalDoc(finalObj);
+    QByteArray finalBytes = finalDoc.toJson(QJsonDocument::Compact);
+
+    // 【新增】内容与上次相同就不再往下游发，省掉解析和写库
+    QByteArray hash = QCryptographicHash::hash(finalBytes, QCryptographicHash::Sha1);
+    if (m_lastPayloadHash.value(cityId) == hash) {
+        qDebug() << "Data unchanged, skip parse/DB ->" << cityId;
+        emit weatherUnchanged(cityId);
+    } else {
+        m_lastPayloadHash.insert(cityId, hash);
+        qDebug() << "Data Fetch Success. Size:" << finalBytes.size();
+        emit weatherReceived(cityId, finalBytes);
+    }
 }
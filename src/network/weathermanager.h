@@ -4,11 +4,39 @@
 #include <QObject>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QNetworkDiskCache>
+#include <QCryptographicHash>
+#include <QHash>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray> // 新增
+#include <QSharedPointer>
+#include <QPointer>
+#include <QFuture>
+#include <QException>
 #include <QDebug>
 
+// 【新增】一次抓取失败的原因；cancelled 表示被新的搜索取代，调用方不用提示
+class FetchError : public QException
+{
+public:
+    explicit FetchError(const QString &msg, bool isCancelled = false)
+        : message(msg), cancelled(isCancelled) {}
+    void raise() const override { throw *this; }
+    FetchError *clone() const override { return new FetchError(*this); }
+
+    QString message;
+    bool cancelled;
+};
+
+// 【新增】一次 getWeather 的上下文：取消标记 + 在途请求，超时或被取代时一起中止
+struct FetchContext {
+    QString cityId;
+    bool cancelled = false;   // 被新的搜索取代
+    bool timedOut = false;    // 超过总时限
+    QList<QPointer<QNetworkReply>> replies;
+};
+
 class WeatherManager : public QObject
 {
     Q_OBJECT
@@ -17,12 +45,28 @@ public:
     ~WeatherManager();
 
     // 对外接口：根据城市名或ID获取天气 (心知天气支持拼音如 "beijing" 或 ID)
+    // 新的调用会中止上一次还没完成的请求 (同一个 WeatherManager 同时只抓一个城市)
     void getWeather(const QString &cityId);
 
+    // 【新增】中止当前在途的请求，不发任何信号
+    void cancel();
+
+    // 【新增】并行抓取 (服务模式用)：不取代其他城市的请求，各城市各有自己的时限，
+    // 一个城市卡住不影响别的城市；同一城市已经在抓时不重复发
+    void fetchWeather(const QString &cityId);
+
+    // 【新增】忘掉某城市上次下发内容的哈希，下次抓到同样的内容也按 weatherReceived 发出
+    // (下游的缓存丢了、需要完整数据时用)
+    void forgetPayload(const QString &cityId) { m_lastPayloadHash.remove(cityId); }
+
 signals:
     // 信号：当数据全部获取并合并完成后发送
     void weatherReceived(QString cityId, QByteArray combinedJson);
     void errorOccurred(QString errorMsg);
+    // 【新增】同上，带上失败的城市 (并行抓取时调用方靠它区分是哪个城市失败了)
+    void fetchFailed(QString cityId, QString errorMsg);
+    // 【新增】合并后的数据与上次完全一样 (服务器返回 304 或内容没变)，不用再解析/写库
+    void weatherUnchanged(QString cityId);
 
 private:
     QNetworkAccessManager *m_manager;
@@ -33,12 +77,36 @@ private:
     // 心知天气通用域名
     const QString API_HOST = "https://api.seniverse.com";
 
-    // 临时存储变量
-    QString m_currentCityId;
-    QJsonObject m_tempNowData; // 暂存实况数据
+    // 【新增】getWeather 当前这次抓取的上下文，新的搜索会中止它
+    QSharedPointer<FetchContext> m_current;
+    // 【新增】fetchWeather 发起的在途抓取 (城市 -> 上下文)
+    QHash<QString, QSharedPointer<FetchContext>> m_parallel;
+
+    // 【新增】每个城市上一次下发数据的哈希，用来判断内容是否变化
+    QHash<QString, QByteArray> m_lastPayloadHash;
+
+    // 【新增】HTTP 磁盘缓存上限 (50 MB)
+    const qint64 HTTP_CACHE_MAX_BYTES = 50 * 1024 * 1024;
+
+    // 【新增】单个请求的传输超时 (这么久没有收到任何数据就中止) / 一次抓取的总时限
+    const int TRANSFER_TIMEOUT_MS = 8000;
+    const int FETCH_BUDGET_MS = 15000;
+
+    // 【新增】统一构造请求：走磁盘缓存 + 条件请求
+    QNetworkRequest makeRequest(const QString &urlStr) const;
+    // 【新增】拼接口地址：参数用 QUrlQuery 编码，城市里带 & # 之类的字符也不会改写其他参数
+    QString apiUrl(const QString &path, const QString &cityId,
+                   const QList<QPair<QString, QString>> &extra = {}) const;
+    // 【新增】发出一次抓取 (实况 + 预报并行)，getWeather / fetchWeather 共用
+    void startFetch(const QSharedPointer<FetchContext> &ctx);
+    void releaseContext(const QSharedPointer<FetchContext> &ctx);
 
-    void requestNowWeather();
-    void requestDailyWeather();
+    // 【修改】抓取流水线：每一步返回 QFuture，失败以 FetchError 传下去
+    QFuture<QJsonObject> fetchResult(const QSharedPointer<FetchContext> &ctx,
+                                     const QString &urlStr, const QString &stage);
+    void abortContext(const QSharedPointer<FetchContext> &ctx, bool timedOut);
+    void finishFetch(const QSharedPointer<FetchContext> &ctx,
+                     const QJsonObject &nowData, const QJsonObject &dailyData);
 };
 
 #endif // WEATHERMANAGER_H
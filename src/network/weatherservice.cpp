@@ -0,0 +1,427 @@
+#include "weatherservice.h"
+#include "dbmanager.h"
+#include "jsonhelper.h"
+#include "cityindex.h"
+#include <QDateTime>
+#include <QUrl>
+#include <algorithm>
+
+WeatherService::WeatherService(QObject *parent) : QObject(parent)
+{
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &WeatherService::onNewConnection);
+
+    m_weatherMgr = new WeatherManager(this);
+    connect(m_weatherMgr, &WeatherManager::weatherReceived, this, &WeatherService::onWeatherReceived);
+    connect(m_weatherMgr, &WeatherManager::weatherUnchanged, this, &WeatherService::onWeatherUnchanged);
+    connect(m_weatherMgr, &WeatherManager::fetchFailed, this, &WeatherService::onFetchError);
+
+    // 城市字典里的坐标写进位置表，/nearest 用 (界面不启动时也要有)
+    CityIndex dictionary;
+    if (dictionary.load(":/resources/data/cities.csv")) {
+        DBManager::getInstance().saveCityLocations(dictionary.locations());
+    }
+}
+
+WeatherService::~WeatherService()
+{
+}
+
+bool WeatherService::listen(quint16 port)
+{
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qDebug() << "服务监听失败:" << m_server->errorString();
+        return false;
+    }
+    qDebug() << "查询服务已启动: http://127.0.0.1:" << m_server->serverPort();
+    return true;
+}
+
+void WeatherService::onNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, &WeatherService::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QObject::destroyed, this, [this, socket]() { m_busySockets.remove(socket); });
+    }
+}
+
+void WeatherService::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket) processSocket(socket);
+}
+
+void WeatherService::processSocket(QTcpSocket *socket)
+{
+    // keep-alive 连接上可能连着来好几个请求，逐个处理 (只支持无正文的 GET)
+    // 前一个请求还在等上游时先不解析，否则后面的应答会抢在它前面写出去
+    while (!m_busySockets.contains(socket)) {
+        QByteArray buffered = socket->peek(MAX_HEADER_BYTES + 4);
+        int end = buffered.indexOf("\r\n\r\n");
+        if (end < 0) {
+            if (buffered.size() > MAX_HEADER_BYTES) {
+                send(socket, buildResponse(431, "Request Header Fields Too Large", "{}"), false);
+            }
+            return; // 头还没收全
+        }
+
+        QByteArray header = socket->read(end + 4);
+        QList<QByteArray> lines = header.split('\n');
+        QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+        if (requestLine.size() < 3) {
+            send(socket, buildResponse(400, "Bad Request", "{}"), false);
+            return;
+        }
+
+        // HTTP/1.1 默认长连接，HTTP/1.0 默认短连接
+        bool keepAlive = requestLine[2] == "HTTP/1.1";
+        for (int i = 1; i < lines.size(); ++i) {
+            QByteArray line = lines[i].trimmed().toLower();
+            if (line.startsWith("connection:")) {
+                keepAlive = line.contains("keep-alive");
+            }
+        }
+
+        handleRequest(socket, requestLine[0], QString::fromLatin1(requestLine[1]), keepAlive);
+        if (!keepAlive || socket->state() != QAbstractSocket::ConnectedState) return;
+    }
+}
+
+void WeatherService::handleRequest(QTcpSocket *socket, const QByteArray &method,
+                                   const QString &target, bool keepAlive)
+{
+    if (method != "GET") {
+        send(socket, buildResponse(405, "Method Not Allowed", "{\"error\":\"only GET\"}"), keepAlive);
+        return;
+    }
+
+    QUrl url("http://localhost" + target);
+    QUrlQuery query(url);
+    const QString path = url.path();
+    const QString cityId = query.queryItemValue("city").trimmed().toLower();
+
+    // 缓存键：路径 + 排好序的参数，参数顺序不同的同一请求共用一份缓存
+    QList<QPair<QString, QString>> items = query.queryItems();
+    std::sort(items.begin(), items.end());
+    QUrlQuery normalized;
+    normalized.setQueryItems(items);
+    const QString cacheKey = path + "?" + normalized.toString();
+
+    auto it = m_responseCache.constFind(cacheKey);
+    if (it != m_responseCache.constEnd() && it->expiresAt > QDateTime::currentMSecsSinceEpoch()) {
+        send(socket, it->bytes, keepAlive);
+        return;
+    }
+
+    if (path != "/weather" && path != "/history" && path != "/aggregate"
+        && path != "/nearest" && path != "/region") {
+        send(socket, buildResponse(404, "Not Found", "{\"error\":\"unknown path\"}"), keepAlive);
+        return;
+    }
+
+    // 区域汇总按区域名查，不需要 city
+    if (path == "/region") {
+        if (query.queryItemValue("name").trimmed().isEmpty()) {
+            send(socket, buildResponse(400, "Bad Request", "{\"error\":\"missing name\"}"), keepAlive);
+            return;
+        }
+        sendCached(socket, cacheKey, buildResponse(200, "OK", buildRegion(query)), HISTORY_TTL_MS, keepAlive);
+        return;
+    }
+
+    if (cityId.isEmpty()) {
+        send(socket, buildResponse(400, "Bad Request", "{\"error\":\"missing city\"}"), keepAlive);
+        return;
+    }
+    if (!isValidCityId(cityId)) {
+        send(socket, buildResponse(400, "Bad Request", "{\"error\":\"invalid city\"}"), keepAlive);
+        return;
+    }
+
+    if (path == "/weather") {
+        handleWeather(socket, cacheKey, cityId, keepAlive);
+    } else if (path == "/history") {
+        sendCached(socket, cacheKey, buildResponse(200, "OK", buildHistory(query)), HISTORY_TTL_MS, keepAlive);
+    } else if (path == "/nearest") {
+        sendCached(socket, cacheKey, buildResponse(200, "OK", buildNearest(query)), HISTORY_TTL_MS, keepAlive);
+    } else {
+        sendCached(socket, cacheKey, buildResponse(200, "OK", buildAggregate(cityId)), HISTORY_TTL_MS, keepAlive);
+    }
+}
+
+void WeatherService::handleWeather(QTcpSocket *socket, const QString &cacheKey,
+                                   const QString &cityId, bool keepAlive)
+{
+    // 数据库缓存还新鲜：直接返回合并后的原始 JSON，不需要再序列化
+    QByteArray cached = DBManager::getInstance().getWeatherCache(cityId);
+    if (!cached.isEmpty()) {
+        sendCached(socket, cacheKey, buildResponse(200, "OK", cached), WEATHER_TTL_MS, keepAlive);
+        return;
+    }
+
+    // 需要联网：挂到等待列表上，同一城市只发一次上游请求
+    m_waiters[cityId].append({ QPointer<QTcpSocket>(socket), cacheKey, keepAlive });
+    m_busySockets.insert(socket);
+    enqueueFetch(cityId);
+}
+
+QByteArray WeatherService::buildHistory(const QUrlQuery &query)
+{
+    const QString cityId = query.queryItemValue("city").trimmed().toLower();
+    QDate from = QDate::fromString(query.queryItemValue("from"), "yyyy-MM-dd");
+    QDate to = QDate::fromString(query.queryItemValue("to"), "yyyy-MM-dd");
+
+    QList<DayWeather> list;
+    if (from.isValid() || to.isValid()) {
+        if (!from.isValid()) from = QDate(1900, 1, 1);
+        if (!to.isValid()) to = QDate::currentDate().addYears(1);
+        list = DBManager::getInstance().getHistoryRange(cityId, from, to);
+    } else {
+        list = DBManager::getInstance().getHistoryData(cityId);
+    }
+
+    QJsonArray days;
+    for (const DayWeather &day : list) {
+        QJsonObject obj;
+        obj["date"] = day.date;
+        obj["high"] = day.high;
+        obj["low"] = day.low;
+        days.append(obj);
+    }
+
+    QJsonObject root;
+    root["city"] = cityId;
+    root["days"] = days;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray WeatherService::buildAggregate(const QString &cityId)
+{
+    QJsonArray months;
+    for (const MonthWeather &m : DBManager::getInstance().getMonthlyHistory(cityId)) {
+        QJsonObject obj;
+        obj["month"] = m.month;
+        obj["avg_high"] = m.avgHigh;
+        obj["avg_low"] = m.avgLow;
+        obj["max_high"] = m.maxHigh;
+        obj["min_low"] = m.minLow;
+        obj["days"] = m.days;
+        months.append(obj);
+    }
+
+    QJsonArray scores;
+    for (const ForecastScore &s : DBManager::getInstance().getForecastScores(cityId)) {
+        QJsonObject obj;
+        obj["lead"] = s.lead;
+        obj["samples"] = s.samples;
+        obj["mae_high"] = s.maeHigh;
+        obj["bias_high"] = s.biasHigh;
+        obj["mae_low"] = s.maeLow;
+        obj["bias_low"] = s.biasLow;
+        scores.append(obj);
+    }
+
+    QJsonObject root;
+    root["city"] = cityId;
+    root["monthly"] = months;
+    root["forecast_scores"] = scores;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray WeatherService::buildNearest(const QUrlQuery &query)
+{
+    const QString cityId = query.queryItemValue("city").trimmed().toLower();
+    int n = query.queryItemValue("n").toInt();
+    if (n <= 0) n = 5;
+    n = qMin(n, MAX_NEAREST);
+    // 默认只要有历史数据的城市，all=1 时包括所有已知坐标的城市
+    const bool withHistoryOnly = query.queryItemValue("all") != "1";
+
+    QJsonArray cities;
+    for (const CityDistance &c : DBManager::getInstance().nearestCities(cityId, n, withHistoryOnly)) {
+        QJsonObject obj;
+        obj["city"] = c.cityId;
+        obj["km"] = qRound(c.km * 10) / 10.0;
+        cities.append(obj);
+    }
+
+    QJsonObject root;
+    root["city"] = cityId;
+    root["nearest"] = cities;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray WeatherService::buildRegion(const QUrlQuery &query)
+{
+    const QString region = query.queryItemValue("name").trimmed();
+    // 月份 yyyyMM，默认最近 12 个月
+    const QDate today = QDate::currentDate();
+    int to = query.queryItemValue("to").toInt();
+    int from = query.queryItemValue("from").toInt();
+    if (to <= 0) to = today.year() * 100 + today.month();
+    if (from <= 0) {
+        QDate start = today.addMonths(-11);
+        from = start.year() * 100 + start.month();
+    }
+
+    QJsonArray months;
+    for (const RegionMonth &m : DBManager::getInstance().getRegionMonthly(region, from, to)) {
+        QJsonObject obj;
+        obj["month"] = m.month;
+        obj["cities"] = m.cities;
+        obj["days"] = m.days;
+        obj["avg_high"] = m.avgHigh;
+        obj["avg_low"] = m.avgLow;
+        obj["max_high"] = m.maxHigh;
+        obj["min_low"] = m.minLow;
+        months.append(obj);
+    }
+
+    QJsonObject root;
+    root["region"] = region;
+    root["cities"] = QJsonArray::fromStringList(DBManager::getInstance().cityLocations().citiesInRegion(region));
+    root["monthly"] = months;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray WeatherService::buildResponse(int status, const QByteArray &reason, const QByteArray &body)
+{
+    QByteArray response;
+    response.reserve(body.size() + 128);
+    response += "HTTP/1.1 " + QByteArray::number(status) + " " + reason + "\r\n";
+    response += "Content-Type: application/json; charset=utf-8\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "\r\n";
+    response += body;
+    return response;
+}
+
+void WeatherService::send(QTcpSocket *socket, const QByteArray &response, bool keepAlive)
+{
+    if (!socket || socket->state() != QAbstractSocket::ConnectedState) return;
+
+    if (keepAlive) {
+        socket->write(response);
+    } else {
+        // 在头部结尾前补一行 Connection: close
+        int headerEnd = response.indexOf("\r\n\r\n");
+        socket->write(response.left(headerEnd + 2));
+        socket->write("Connection: close\r\n");
+        socket->write(response.mid(headerEnd + 2));
+        socket->disconnectFromHost();
+    }
+}
+
+void WeatherService::sendCached(QTcpSocket *socket, const QString &cacheKey, const QByteArray &response,
+                                int ttlMs, bool keepAlive)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    // 缓存条目太多时先清掉过期的，还是太多就整个清空 (history 的 from/to 组合可能很多)
+    if (m_responseCache.size() >= MAX_CACHED_RESPONSES) {
+        for (auto it = m_responseCache.begin(); it != m_responseCache.end();) {
+            if (it->expiresAt <= now) it = m_responseCache.erase(it);
+            else ++it;
+        }
+        if (m_responseCache.size() >= MAX_CACHED_RESPONSES) m_responseCache.clear();
+    }
+
+    m_responseCache.insert(cacheKey, { response, now + ttlMs });
+    send(socket, response, keepAlive);
+}
+
+// ======================= 上游请求 (合并 + 排队) =======================
+
+bool WeatherService::isValidCityId(const QString &cityId)
+{
+    // 拼音 (beijing)、心知城市ID (WX4FBXXFKE4F，已转小写)、经纬度 (39.93:116.40)
+    // 不允许 & # = % 空格等，避免拼进上游地址后改写其他参数
+    if (cityId.size() > 64) return false;
+    for (QChar c : cityId) {
+        const ushort u = c.unicode();
+        const bool ok = (u >= 'a' && u <= 'z') || (u >= '0' && u <= '9')
+                        || u == ':' || u == '.' || u == '_' || u == '-';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+void WeatherService::enqueueFetch(const QString &cityId)
+{
+    // 正在拉或已经在排队的城市，不重复请求
+    if (m_fetching.contains(cityId) || m_fetchQueue.contains(cityId)) return;
+
+    m_fetchQueue.append(cityId);
+    startNextFetch();
+}
+
+void WeatherService::startNextFetch()
+{
+    while (!m_fetchQueue.isEmpty() && m_fetching.size() < MAX_PARALLEL_FETCHES) {
+        const QString cityId = m_fetchQueue.takeFirst();
+        m_fetching.insert(cityId);
+        m_weatherMgr->fetchWeather(cityId);
+    }
+}
+
+void WeatherService::finishFetch(const QString &cityId, const QByteArray &response)
+{
+    const QList<Waiter> waiters = m_waiters.take(cityId);
+    const bool ok = response.startsWith("HTTP/1.1 200");
+
+    for (const Waiter &w : waiters) {
+        if (ok) {
+            sendCached(w.socket, w.cacheKey, response, WEATHER_TTL_MS, w.keepAlive);
+        } else {
+            send(w.socket, response, w.keepAlive);
+        }
+
+        // 应答已按顺序写出，接着处理这条连接上排在后面的请求
+        // (放到事件循环里做，避免在这里重入 handleWeather / m_waiters)
+        if (!w.socket) continue;
+        m_busySockets.remove(w.socket);
+        if (w.keepAlive && w.socket->bytesAvailable() > 0) {
+            QPointer<QTcpSocket> socket = w.socket;
+            QMetaObject::invokeMethod(this, [this, socket]() {
+                if (socket && socket->state() == QAbstractSocket::ConnectedState) processSocket(socket);
+            }, Qt::QueuedConnection);
+        }
+    }
+
+    if (m_fetching.remove(cityId)) startNextFetch();
+}
+
+void WeatherService::onWeatherReceived(QString cityId, QByteArray data)
+{
+    // 与界面相同：写缓存、观测日志和历史，其他客户端之后直接命中
+    TodayWeather weather = JsonHelper::parseWeatherJson(data);
+    DBManager::getInstance().cacheWeather(cityId, weather.city, data);
+    DBManager::getInstance().appendObservation(cityId, weather);
+    DBManager::getInstance().saveCityLocation(cityId, weather);
+    DBManager::getInstance().saveForecast(cityId, weather.forecast, weather.issueDate);
+
+    finishFetch(cityId, buildResponse(200, "OK", data));
+}
+
+void WeatherService::onWeatherUnchanged(QString cityId)
+{
+    DBManager::getInstance().touchWeatherCache(cityId);
+    QByteArray cached = DBManager::getInstance().getWeatherCache(cityId);
+    if (cached.isEmpty()) {
+        // 缓存行已经被清理：让 WeatherManager 忘掉上次的内容，重新完整拉一次 (等待者继续等)
+        m_weatherMgr->forgetPayload(cityId);
+        m_weatherMgr->fetchWeather(cityId);
+    } else {
+        finishFetch(cityId, buildResponse(200, "OK", cached));
+    }
+}
+
+void WeatherService::onFetchError(QString cityId, QString errorMsg)
+{
+    qDebug() << "上游请求失败:" << cityId << errorMsg;
+    QJsonObject err;
+    err["error"] = errorMsg;
+    finishFetch(cityId,
+                buildResponse(502, "Bad Gateway", QJsonDocument(err).toJson(QJsonDocument::Compact)));
+}
@@ -0,0 +1,105 @@
+#ifndef WEATHERSERVICE_H
+#define WEATHERSERVICE_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QPointer>
+#include <QHash>
+#include <QSet>
+#include <QUrlQuery>
+#include "weathermanager.h"
+
+/**
+ * @brief 本机只读查询服务 (回环 HTTP)
+ * 多个桌面/看板共用一份数据库和缓存，只有这里会去请求上游接口。
+ *
+ *   GET /weather?city=beijing                         当前天气 (合并后的原始 JSON)
+ *   GET /history?city=beijing&from=2026-01-01&to=...  历史逐日数据 (from/to 可省略)
+ *   GET /aggregate?city=beijing                       月度汇总 + 预报准确度
+ *   GET /nearest?city=beijing&n=5&all=0               最近的 n 个 (有历史数据的) 城市
+ *   GET /region?name=广东,中国&from=202601&to=202603    区域月度汇总 (区域 = 行政区划路径后缀)
+ *
+ * 所有响应都按 URL 缓存为完整的 HTTP 报文 (头 + 正文)，命中时直接写 socket；
+ * 同一城市同时有多个 /weather 请求且需要联网时，只发一次上游请求，结果广播给所有等待者；
+ * 不同城市的上游请求并行 (最多 MAX_PARALLEL_FETCHES 个)，一个城市卡住不会拖住别的城市。
+ * city 参数只接受字母、数字和 : . _ - (拼音、心知城市ID、经纬度)，其余直接 400。
+ * 同一连接上的流水线请求按顺序应答：某个请求在等上游时，后面的请求先留在 socket 里不解析。
+ */
+class WeatherService : public QObject
+{
+    Q_OBJECT
+public:
+    explicit WeatherService(QObject *parent = nullptr);
+    ~WeatherService();
+
+    // 只监听 127.0.0.1
+    bool listen(quint16 port);
+    quint16 port() const { return m_server->serverPort(); }
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+    void onWeatherReceived(QString cityId, QByteArray data);
+    void onWeatherUnchanged(QString cityId);
+    void onFetchError(QString cityId, QString errorMsg);
+
+private:
+    struct CachedResponse {
+        QByteArray bytes;     // 完整 HTTP 响应
+        qint64 expiresAt;     // 毫秒时间戳
+    };
+
+    // 解析并处理 socket 里已收全的请求，直到没有完整请求或者该连接在等上游
+    void processSocket(QTcpSocket *socket);
+    void handleRequest(QTcpSocket *socket, const QByteArray &method, const QString &target, bool keepAlive);
+    void handleWeather(QTcpSocket *socket, const QString &cacheKey, const QString &cityId, bool keepAlive);
+    QByteArray buildHistory(const QUrlQuery &query);
+    QByteArray buildAggregate(const QString &cityId);
+    QByteArray buildNearest(const QUrlQuery &query);
+    QByteArray buildRegion(const QUrlQuery &query);
+
+    // 拼出完整响应报文 (keep-alive 与否不进缓存，写出时再补 Connection 头)
+    static QByteArray buildResponse(int status, const QByteArray &reason, const QByteArray &body);
+    void send(QTcpSocket *socket, const QByteArray &response, bool keepAlive);
+    void sendCached(QTcpSocket *socket, const QString &cacheKey, const QByteArray &response,
+                    int ttlMs, bool keepAlive);
+
+    // 上游请求：不同城市并行 (WeatherManager::fetchWeather)，超过并发上限的排队
+    void enqueueFetch(const QString &cityId);
+    void startNextFetch();
+    void finishFetch(const QString &cityId, const QByteArray &response);
+    static bool isValidCityId(const QString &cityId);
+
+    QTcpServer *m_server;
+    WeatherManager *m_weatherMgr;
+
+    QHash<QString, CachedResponse> m_responseCache;
+
+    // 等待某城市上游结果的连接 (socket, cacheKey, keepAlive)
+    struct Waiter {
+        QPointer<QTcpSocket> socket;
+        QString cacheKey;
+        bool keepAlive;
+    };
+    QHash<QString, QList<Waiter>> m_waiters;
+    // 有请求挂在 m_waiters 上的连接，应答发出之前不处理它后面的请求
+    QSet<QTcpSocket*> m_busySockets;
+    QStringList m_fetchQueue;
+    QSet<QString> m_fetching;   // 正在抓的城市
+
+    // 各接口的响应缓存时间
+    const int WEATHER_TTL_MS = 60 * 1000;
+    const int HISTORY_TTL_MS = 5 * 60 * 1000;
+    // 响应缓存最多保留的条目数
+    const int MAX_CACHED_RESPONSES = 1024;
+    // 同时向上游抓取的城市数上限
+    const int MAX_PARALLEL_FETCHES = 4;
+    // /nearest 最多返回的城市数
+    const int MAX_NEAREST = 50;
+    // 单个请求头最大长度，防止异常客户端占满内存
+    const int MAX_HEADER_BYTES = 16 * 1024;
+};
+
+#endif // WEATHERSERVICE_H
@@ -0,0 +1,130 @@
+// 查询服务压测工具
+// 用法: WeatherServiceBench [--host 127.0.0.1] [--port 8765] [--path "/weather?city=beijing"]
+//                           [--clients 64] [--seconds 10]
+// 每个客户端一条 keep-alive 连接，收到响应后立即发下一个请求，
+// 结束后输出吞吐 (请求/秒) 和延迟分位数 (p50/p90/p99/max)。
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include <QTextStream>
+#include <algorithm>
+
+class BenchClient : public QObject
+{
+public:
+    BenchClient(const QString &host, quint16 port, const QByteArray &request,
+                QVector<qint64> *latencies, int *errors, QObject *parent)
+        : QObject(parent), m_request(request), m_latencies(latencies), m_errors(errors)
+    {
+        connect(&m_socket, &QTcpSocket::connected, this, [this]() { sendRequest(); });
+        connect(&m_socket, &QTcpSocket::readyRead, this, [this]() { onReadyRead(); });
+        connect(&m_socket, &QTcpSocket::errorOccurred, this, [this]() { ++(*m_errors); });
+        m_socket.connectToHost(host, port);
+    }
+
+    void stop() { m_stopped = true; m_socket.abort(); }
+
+private:
+    void sendRequest()
+    {
+        if (m_stopped) return;
+        m_buffer.clear();
+        m_timer.start();
+        m_socket.write(m_request);
+    }
+
+    void onReadyRead()
+    {
+        m_buffer += m_socket.readAll();
+
+        int headerEnd = m_buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0) return;
+
+        // 按 Content-Length 判断一个响应是否收完
+        int length = 0;
+        const QList<QByteArray> lines = m_buffer.left(headerEnd).split('\n');
+        for (const QByteArray &line : lines) {
+            if (line.toLower().startsWith("content-length:")) {
+                length = line.mid(15).trimmed().toInt();
+            }
+        }
+        if (m_buffer.size() < headerEnd + 4 + length) return;
+
+        if (!m_buffer.startsWith("HTTP/1.1 200")) ++(*m_errors);
+        m_latencies->append(m_timer.nsecsElapsed() / 1000);
+        sendRequest();
+    }
+
+    QTcpSocket m_socket;
+    QByteArray m_request;
+    QByteArray m_buffer;
+    QElapsedTimer m_timer;
+    QVector<qint64> *m_latencies;
+    int *m_errors;
+    bool m_stopped = false;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({ "host", "服务地址", "host", "127.0.0.1" });
+    parser.addOption({ "port", "服务端口", "port", "8765" });
+    parser.addOption({ "path", "请求路径", "path", "/weather?city=beijing" });
+    parser.addOption({ "clients", "并发连接数", "n", "64" });
+    parser.addOption({ "seconds", "压测时长 (秒)", "s", "10" });
+    parser.process(app);
+
+    const QString host = parser.value("host");
+    const quint16 port = quint16(parser.value("port").toUInt());
+    const int clients = qMax(1, parser.value("clients").toInt());
+    const int seconds = qMax(1, parser.value("seconds").toInt());
+    const QByteArray request = "GET " + parser.value("path").toUtf8() + " HTTP/1.1\r\n"
+                               "Host: " + host.toUtf8() + "\r\n"
+                               "Connection: keep-alive\r\n\r\n";
+
+    QVector<qint64> latencies;   // 微秒
+    latencies.reserve(1 << 20);
+    int errors = 0;
+
+    QList<BenchClient*> pool;
+    for (int i = 0; i < clients; ++i) {
+        pool << new BenchClient(host, port, request, &latencies, &errors, &app);
+    }
+
+    QElapsedTimer wall;
+    wall.start();
+
+    QTimer::singleShot(seconds * 1000, &app, [&]() {
+        for (BenchClient *c : pool) c->stop();
+        const double elapsed = wall.nsecsElapsed() / 1e9;
+
+        QTextStream out(stdout);
+        if (latencies.isEmpty()) {
+            out << "没有成功的请求 (错误 " << errors << ")\n";
+            app.exit(1);
+            return;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        auto pct = [&](double p) {
+            int idx = qMin(latencies.size() - 1, int(p * latencies.size()));
+            return latencies[idx] / 1000.0;
+        };
+
+        out << "clients: " << clients << "  seconds: " << elapsed << "\n";
+        out << "requests: " << latencies.size() << "  errors: " << errors << "\n";
+        out << "throughput: " << latencies.size() / elapsed << " req/s\n";
+        out << "latency ms  p50: " << pct(0.50) << "  p90: " << pct(0.90)
+            << "  p99: " << pct(0.99) << "  max: " << latencies.last() / 1000.0 << "\n";
+        app.exit(0);
+    });
+
+    return app.exec();
+}
@@ -0,0 +1,171 @@
+#include "chartexportjob.h"
+#include "chartrenderer.h"
+#include "dbmanager.h"
+#include "dbreadpool.h"
+#include "cityindex.h"
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <QTextStream>
+
+namespace {
+
+// CSV 字段：含逗号、引号或换行时加引号，内部的引号写两遍
+QString csvField(const QString &value)
+{
+    if (!value.contains(QLatin1Char(',')) && !value.contains(QLatin1Char('"'))
+        && !value.contains(QLatin1Char('\n')) && !value.contains(QLatin1Char('\r'))) {
+        return value;
+    }
+    QString escaped = value;
+    escaped.replace(QLatin1String("\""), QLatin1String("\"\""));
+    return QLatin1Char('"') + escaped + QLatin1Char('"');
+}
+
+// 【新增】城市 ID 来自命令行或列式文件，不能直接当文件名 ("../x" 会写到导出目录外面)
+// 只保留字母、数字、'-'、'_'，其余字符 (含 '.', '/', '\\') 都换成 '_'
+QString safeFileName(const QString &cityId)
+{
+    QString name;
+    name.reserve(cityId.size());
+    for (const QChar c : cityId) {
+        const bool plain = (c >= QLatin1Char('a') && c <= QLatin1Char('z'))
+                           || (c >= QLatin1Char('A') && c <= QLatin1Char('Z'))
+                           || (c >= QLatin1Char('0') && c <= QLatin1Char('9'))
+                           || c == QLatin1Char('-') || c == QLatin1Char('_');
+        name += plain ? c : QLatin1Char('_');
+    }
+    return name.isEmpty() ? QStringLiteral("_") : name.left(64);
+}
+
+} // namespace
+
+ChartExportJob::ChartExportJob(QObject *parent) : QObject(parent)
+{
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+ChartExportJob::~ChartExportJob()
+{
+    // 任务里会回调 this，必须等它们都结束
+    m_pool.waitForDone();
+}
+
+bool ChartExportJob::start(const QStringList &cityIds)
+{
+    if (isRunning() || cityIds.isEmpty()) return false;
+
+    if (m_outputDir.isEmpty() || !QDir().mkpath(m_outputDir)) {
+        qDebug() << "导出目录不可用:" << m_outputDir;
+        return false;
+    }
+
+    const bool fromColumnar = !m_columnarPath.isEmpty();
+    if (fromColumnar && !m_columnar.open(m_columnarPath)) {
+        qDebug() << "列式文件不可用:" << m_columnarPath;
+        return false;
+    }
+
+    m_items.clear();
+    m_items.resize(cityIds.size());
+    m_done = 0;
+    m_pending = cityIds.size();
+
+    const QString suffix = (m_format == Svg) ? ".svg" : ".png";
+
+    // 【修改】各城市的历史用只读连接池并行查出来，不再在主线程逐个查
+    // 有列式文件时不查库，每个任务直接读映射内存里的列
+    QHash<QString, QList<DayWeather>> histories;
+    if (!fromColumnar) histories = DBReadPool::getInstance().getHistoryForCities(cityIds);
+
+    // 【新增】列式数据源不依赖数据库，城市中文名从内置字典查 (查不到就用 ID)
+    CityIndex dictionary;
+    if (fromColumnar) dictionary.load(":/resources/data/cities.csv");
+
+    QSet<QString> usedNames;
+    for (int i = 0; i < cityIds.size(); ++i) {
+        Item &item = m_items[i];
+        item.cityId = cityIds[i];
+        if (fromColumnar) {
+            const CityInfo *info = dictionary.find(item.cityId);
+            item.cityName = info ? info->name : item.cityId;
+        } else {
+            item.cityName = DBManager::getInstance().getCityName(item.cityId);
+        }
+
+        // 不同 ID 清洗后可能撞名，撞了就加序号
+        const QString base = safeFileName(item.cityId);
+        QString name = base;
+        for (int n = 2; usedNames.contains(name.toLower()); ++n) name = base + '_' + QString::number(n);
+        usedNames.insert(name.toLower());
+        item.fileName = name + suffix;
+
+        // 读完的数据按值拷贝进任务 (列式数据只传指针，映射在导出结束前一直有效)
+        QList<DayWeather> data = histories.value(item.cityId);
+        const HistoryColumns cols = fromColumnar ? m_columnar.columns(item.cityId) : HistoryColumns();
+        item.days = fromColumnar ? cols.count : data.size();
+
+        const QString filePath = QDir(m_outputDir).filePath(item.fileName);
+        const QString title = item.cityName + " - 气温趋势";
+        const Format format = m_format;
+        const QSize size = m_imageSize;
+        const bool isNight = m_isNight;
+
+        m_pool.start([this, i, data, cols, fromColumnar, filePath, title, format, size, isNight]() {
+            const ChartRenderer::TempSeries series =
+                fromColumnar ? ChartRenderer::tempSeries(cols) : ChartRenderer::tempSeries(data);
+            bool ok = false;
+            if (format == Svg) {
+                ok = ChartRenderer::renderSvg(filePath, series, title, size, isNight);
+            } else {
+                QImage image = ChartRenderer::renderImage(series, title, size, isNight);
+                ok = image.save(filePath, "PNG");
+            }
+            // 回到 this 所在线程汇总，避免加锁
+            QMetaObject::invokeMethod(this, [this, i, ok]() { onItemDone(i, ok); },
+                                      Qt::QueuedConnection);
+        });
+    }
+    return true;
+}
+
+void ChartExportJob::onItemDone(int index, bool ok)
+{
+    m_items[index].ok = ok;
+    if (!ok) {
+        qDebug() << "导出失败:" << m_items[index].cityId;
+    }
+
+    ++m_done;
+    --m_pending;
+    emit progress(m_done, m_items.size());
+
+    if (m_pending == 0) {
+        int succeeded = 0;
+        for (const Item &item : m_items) {
+            if (item.ok) ++succeeded;
+        }
+        QString indexPath = writeIndex();
+        m_columnar.close();
+        qDebug() << "图表导出完成:" << succeeded << "/" << m_items.size();
+        emit finished(succeeded, indexPath);
+    }
+}
+
+QString ChartExportJob::writeIndex()
+{
+    const QString indexPath = QDir(m_outputDir).filePath("index.csv");
+    QFile file(indexPath);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate | QFile::Text)) {
+        qDebug() << "索引文件写入失败:" << indexPath;
+        return QString();
+    }
+
+    QTextStream out(&file);
+    out << "city_id,city_name,file,days,status\n";
+    for (const Item &item : m_items) {
+        out << csvField(item.cityId) << ',' << csvField(item.cityName) << ','
+            << csvField(item.fileName) << ',' << item.days << ',' << (item.ok ? "ok" : "failed") << '\n';
+    }
+    return indexPath;
+}
@@ -0,0 +1,74 @@
+#ifndef CHARTEXPORTJOB_H
+#define CHARTEXPORTJOB_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QStringList>
+#include <QSize>
+#include <QVector>
+#include "weatherdata.h"
+#include "columnarhistory.h"
+
+/**
+ * @brief 批量导出气温图 (日报用)
+ * 1. 通过只读连接池 (DBReadPool) 并行读出各城市历史数据；
+ *    或者指定列式文件 (.whc)，直接用映射内存里的列，不查数据库
+ * 2. 把绘制 + 写文件分发到线程池，每个任务在自己的 QImage 上用独立的 QPainter 画
+ * 3. 全部完成后按输入顺序写出 index.csv
+ */
+class ChartExportJob : public QObject
+{
+    Q_OBJECT
+public:
+    enum Format { Png, Svg };
+
+    explicit ChartExportJob(QObject *parent = nullptr);
+    ~ChartExportJob();
+
+    void setOutputDir(const QString &dir) { m_outputDir = dir; }
+    void setFormat(Format format) { m_format = format; }
+    void setImageSize(const QSize &size) { m_imageSize = size; }
+    void setNightMode(bool isNight) { m_isNight = isNight; }
+    // 【新增】从列式文件读历史 (见 ColumnarHistoryReader)，为空时查数据库
+    void setColumnarSource(const QString &filePath) { m_columnarPath = filePath; }
+    // 工作线程数，默认等于 CPU 核数
+    void setMaxThreads(int count) { m_pool.setMaxThreadCount(count); }
+
+    // 开始导出 (异步)，返回 false 表示参数有误或上一次还没导完
+    bool start(const QStringList &cityIds);
+
+    bool isRunning() const { return m_pending > 0; }
+
+signals:
+    void progress(int done, int total);
+    // 全部完成：成功数量 + 索引文件路径
+    void finished(int succeeded, const QString &indexPath);
+
+private:
+    struct Item {
+        QString cityId;
+        QString cityName;
+        QString fileName;   // 相对 m_outputDir 的文件名
+        int days = 0;
+        bool ok = false;
+    };
+
+    void onItemDone(int index, bool ok);
+    QString writeIndex();
+
+    QThreadPool m_pool;
+    QString m_outputDir;
+    Format m_format = Png;
+    QSize m_imageSize = QSize(800, 450);
+    bool m_isNight = false;
+
+    // 列式数据源：导出期间保持映射，任务直接读里面的列
+    QString m_columnarPath;
+    ColumnarHistoryReader m_columnar;
+
+    QVector<Item> m_items;
+    int m_pending = 0;
+    int m_done = 0;
+};
+
+#endif // CHARTEXPORTJOB_H
@@ -0,0 +1,330 @@
+#include "chartrenderer.h"
+#include "themehelper.h"
+#include <QSvgGenerator>
+
+namespace {
+
+// 两条渲染路径共用的样式
+const QColor HIGH_COLOR(Qt::red);
+const QColor LOW_COLOR(Qt::blue);
+const int LINE_WIDTH = 3;
+const int Y_MARGIN = 3;         // Y 轴上下各留 3 度余量
+
+QString pointLabel(int temp) { return QString("%1°").arg(temp); }
+QString axisLabel(int temp) { return QString("%1 C").arg(temp); }
+
+void fitYRange(ChartRenderer::TempSeries &series)
+{
+    int minTemp = 100;
+    int maxTemp = -100;
+    for (int i = 0; i < series.size(); ++i) {
+        if (series.lows[i] < minTemp) minTemp = series.lows[i];
+        if (series.highs[i] > maxTemp) maxTemp = series.highs[i];
+    }
+    series.yMin = minTemp - Y_MARGIN;
+    series.yMax = maxTemp + Y_MARGIN;
+}
+
+} // namespace
+
+QString ChartRenderer::TempSeries::label(int i) const
+{
+    return days[i] ? QDate::fromJulianDay(days[i]).toString("MM/dd") : QString();
+}
+
+ChartRenderer::TempSeries ChartRenderer::tempSeries(const QList<DayWeather> &list)
+{
+    TempSeries series;
+    series.days.reserve(list.size());
+    series.highs.reserve(list.size());
+    series.lows.reserve(list.size());
+    for (const DayWeather &day : list) {
+        const QDate date = QDate::fromString(day.date, "yyyy-MM-dd");
+        series.days.append(date.isValid() ? qint32(date.toJulianDay()) : 0);
+        series.highs.append(day.high);
+        series.lows.append(day.low);
+    }
+    fitYRange(series);
+    return series;
+}
+
+ChartRenderer::TempSeries ChartRenderer::tempSeries(const HistoryColumns &cols)
+{
+    // 列里本来就是儒略日和整数温度，直接拷成 X/Y，不经过日期字符串
+    TempSeries series;
+    series.days = QVector<qint32>(cols.julianDays, cols.julianDays + cols.count);
+    series.highs.reserve(cols.count);
+    series.lows.reserve(cols.count);
+    for (int i = 0; i < cols.count; ++i) {
+        series.highs.append(cols.high[i]);
+        series.lows.append(cols.low[i]);
+    }
+    fitYRange(series);
+    return series;
+}
+
+QChart *ChartRenderer::buildTempChart(const QList<DayWeather> &list, const QString &title, bool isNight)
+{
+    return buildTempChart(tempSeries(list), title, isNight);
+}
+
+QChart *ChartRenderer::buildTempChart(const TempSeries &series, const QString &title, bool isNight)
+{
+    QChart *chart = new QChart();
+    chart->setBackgroundRoundness(0);
+    chart->setBackgroundVisible(false);
+    chart->setTitle(title);
+    chart->legend()->setVisible(false);
+
+    QLineSeries *highSeries = new QLineSeries();
+    QLineSeries *lowSeries = new QLineSeries();
+
+    QStringList categories;
+    for (int i = 0; i < series.size(); ++i) {
+        highSeries->append(i, series.highs[i]);
+        lowSeries->append(i, series.lows[i]);
+        categories << series.label(i);
+    }
+
+    chart->addSeries(highSeries);
+    chart->addSeries(lowSeries);
+
+    // --- 线条与数值 ---
+    QPen highPen(HIGH_COLOR); highPen.setWidth(LINE_WIDTH); highSeries->setPen(highPen);
+    highSeries->setPointLabelsVisible(true);
+    highSeries->setPointLabelsFormat("@yPoint°");
+
+    QPen lowPen(LOW_COLOR); lowPen.setWidth(LINE_WIDTH); lowSeries->setPen(lowPen);
+    lowSeries->setPointLabelsVisible(true);
+    lowSeries->setPointLabelsFormat("@yPoint°");
+
+    // --- X 轴 ---
+    QBarCategoryAxis *axisX = new QBarCategoryAxis();
+    axisX->append(categories);
+    axisX->setGridLineVisible(false);
+    chart->addAxis(axisX, Qt::AlignBottom);
+    highSeries->attachAxis(axisX);
+    lowSeries->attachAxis(axisX);
+
+    // --- Y 轴 ---
+    QValueAxis *axisY = new QValueAxis();
+    axisY->setRange(series.yMin, series.yMax);
+    // 使用标准 Unicode 防止乱码
+    axisY->setLabelFormat("%d C");
+
+    chart->addAxis(axisY, Qt::AlignLeft);
+    highSeries->attachAxis(axisY);
+    lowSeries->attachAxis(axisY);
+
+    applyTheme(chart, isNight);
+    return chart;
+}
+
+QChart *ChartRenderer::buildIntradayChart(const QList<NowObservation> &list, const QString &title, bool isNight)
+{
+    QChart *chart = new QChart();
+    chart->setBackgroundRoundness(0);
+    chart->setBackgroundVisible(false);
+    chart->setTitle(title);
+    chart->legend()->setVisible(false);
+
+    QLineSeries *tempSeries = new QLineSeries();
+
+    int minTemp = 100;
+    int maxTemp = -100;
+    for (const NowObservation &obs : list) {
+        // QDateTimeAxis 使用毫秒
+        tempSeries->append(obs.time * 1000.0, obs.temp);
+        if (obs.temp < minTemp) minTemp = obs.temp;
+        if (obs.temp > maxTemp) maxTemp = obs.temp;
+    }
+
+    chart->addSeries(tempSeries);
+
+    // --- 线条与数值 ---
+    QPen tempPen(QColor(255, 140, 0)); tempPen.setWidth(3); tempSeries->setPen(tempPen);
+    tempSeries->setPointsVisible(true);
+    // 点多了数值会挤在一起，只在点少时显示
+    tempSeries->setPointLabelsVisible(list.size() <= 24);
+    tempSeries->setPointLabelsFormat("@yPoint°");
+
+    // --- X 轴 (时间) ---
+    QDateTimeAxis *axisX = new QDateTimeAxis();
+    axisX->setFormat("HH:mm");
+    axisX->setTickCount(7);
+    axisX->setGridLineVisible(false);
+    chart->addAxis(axisX, Qt::AlignBottom);
+    tempSeries->attachAxis(axisX);
+
+    // --- Y 轴 ---
+    QValueAxis *axisY = new QValueAxis();
+    axisY->setRange(minTemp - 3, maxTemp + 3);
+    axisY->setLabelFormat("%d C");
+    chart->addAxis(axisY, Qt::AlignLeft);
+    tempSeries->attachAxis(axisY);
+
+    applyTheme(chart, isNight);
+    return chart;
+}
+
+void ChartRenderer::applyTheme(QChart *chart, bool isNight)
+{
+    if (!chart) return;
+
+    QColor textColor = ThemeHelper::chartTextColor(isNight);
+    QColor gridColor = ThemeHelper::chartGridColor(isNight);
+
+    chart->setTitleBrush(textColor);
+
+    const QList<QAbstractSeries*> seriesList = chart->series();
+    for (QAbstractSeries *s : seriesList) {
+        if (QXYSeries *xy = qobject_cast<QXYSeries*>(s)) {
+            xy->setPointLabelsColor(textColor);
+        }
+    }
+
+    const QList<QAbstractAxis*> axesX = chart->axes(Qt::Horizontal);
+    for (QAbstractAxis *axis : axesX) {
+        axis->setLabelsColor(textColor);
+        axis->setLinePen(QPen(textColor)); // 轴线颜色
+    }
+
+    // 网格线设为虚线
+    QPen gridPen(gridColor);
+    gridPen.setStyle(Qt::DashLine);
+    const QList<QAbstractAxis*> axesY = chart->axes(Qt::Vertical);
+    for (QAbstractAxis *axis : axesY) {
+        axis->setLabelsColor(textColor);
+        axis->setGridLinePen(gridPen);
+    }
+}
+
+void ChartRenderer::paintTempChart(QPainter *painter, const QRectF &rect,
+                                   const TempSeries &series, const QString &title, bool isNight)
+{
+    QColor textColor = ThemeHelper::chartTextColor(isNight);
+    QColor gridColor = ThemeHelper::chartGridColor(isNight);
+
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+
+    // 1. 标题
+    QFont titleFont = painter->font();
+    titleFont.setPointSize(12);
+    titleFont.setBold(true);
+    painter->setFont(titleFont);
+    painter->setPen(textColor);
+    const qreal titleHeight = QFontMetricsF(titleFont).height() + 8;
+    painter->drawText(QRectF(rect.left(), rect.top(), rect.width(), titleHeight),
+                      Qt::AlignCenter, title);
+
+    if (series.isEmpty()) {
+        painter->restore();
+        return;
+    }
+
+    QFont labelFont = painter->font();
+    labelFont.setPointSize(9);
+    labelFont.setBold(false);
+    painter->setFont(labelFont);
+    const QFontMetricsF fm(labelFont);
+
+    // 2. 绘图区 (左边留 Y 轴刻度，下边留日期)
+    QRectF area;
+    area.setLeft(rect.left() + fm.horizontalAdvance("-00 C") + 12);
+    area.setTop(rect.top() + titleHeight + fm.height());
+    area.setRight(rect.right() - 12);
+    area.setBottom(rect.bottom() - fm.height() - 10);
+    if (area.width() <= 0 || area.height() <= 0) {
+        painter->restore();
+        return;
+    }
+
+    const int yMin = series.yMin;
+    const int yMax = series.yMax;
+
+    auto yPos = [&](int temp) {
+        return area.bottom() - (temp - yMin) * area.height() / (yMax - yMin);
+    };
+    // 类目轴：每个日期占一格，点画在格子中间
+    const qreal slot = area.width() / series.size();
+    auto xPos = [&](int i) {
+        return area.left() + slot * (i + 0.5);
+    };
+
+    // 3. Y 轴虚线网格 + 刻度
+    QPen gridPen(gridColor);
+    gridPen.setStyle(Qt::DashLine);
+    const int ticks = 5;
+    for (int t = 0; t < ticks; ++t) {
+        int value = yMin + (yMax - yMin) * t / (ticks - 1);
+        qreal y = yPos(value);
+        painter->setPen(gridPen);
+        painter->drawLine(QPointF(area.left(), y), QPointF(area.right(), y));
+        painter->setPen(textColor);
+        painter->drawText(QRectF(rect.left(), y - fm.height() / 2, area.left() - rect.left() - 6, fm.height()),
+                          Qt::AlignRight | Qt::AlignVCenter, axisLabel(value));
+    }
+
+    // 4. X 轴线 + 日期
+    painter->setPen(textColor);
+    painter->drawLine(area.bottomLeft(), area.bottomRight());
+    for (int i = 0; i < series.size(); ++i) {
+        painter->drawText(QRectF(area.left() + slot * i, area.bottom() + 4, slot, fm.height()),
+                          Qt::AlignCenter, series.label(i));
+    }
+
+    // 5. 高温(红) / 低温(蓝) 折线 + 数值
+    auto drawSeries = [&](const QColor &color, const QVector<int> &values) {
+        QPolygonF line;
+        for (int i = 0; i < values.size(); ++i) {
+            line << QPointF(xPos(i), yPos(values[i]));
+        }
+        QPen pen(color);
+        pen.setWidth(LINE_WIDTH);
+        painter->setPen(pen);
+        painter->drawPolyline(line);
+
+        painter->setPen(textColor);
+        for (int i = 0; i < line.size(); ++i) {
+            painter->drawText(QRectF(line[i].x() - slot / 2, line[i].y() - fm.height() - 4, slot, fm.height()),
+                              Qt::AlignCenter, pointLabel(values[i]));
+        }
+    };
+    drawSeries(HIGH_COLOR, series.highs);
+    drawSeries(LOW_COLOR, series.lows);
+
+    painter->restore();
+}
+
+QImage ChartRenderer::renderImage(const TempSeries &series, const QString &title,
+                                  const QSize &size, bool isNight)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    // 导出的图片要放进报表，背景不透明：日间白底，夜间深色
+    image.fill(isNight ? QColor("#203a43") : QColor(Qt::white));
+
+    QPainter painter(&image);
+    paintTempChart(&painter, QRectF(QPointF(0, 0), QSizeF(size)), series, title, isNight);
+    painter.end();
+    return image;
+}
+
+bool ChartRenderer::renderSvg(const QString &filePath, const TempSeries &series,
+                              const QString &title, const QSize &size, bool isNight)
+{
+    QSvgGenerator generator;
+    generator.setFileName(filePath);
+    generator.setSize(size);
+    generator.setViewBox(QRect(QPoint(0, 0), size));
+    generator.setTitle(title);
+
+    QPainter painter;
+    if (!painter.begin(&generator)) {
+        qDebug() << "SVG 创建失败:" << filePath;
+        return false;
+    }
+    painter.fillRect(QRect(QPoint(0, 0), size), isNight ? QColor("#203a43") : QColor(Qt::white));
+    paintTempChart(&painter, QRectF(QPointF(0, 0), QSizeF(size)), series, title, isNight);
+    return painter.end();
+}
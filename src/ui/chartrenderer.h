@@ -0,0 +1,64 @@
+#ifndef CHARTRENDERER_H
+#define CHARTRENDERER_H
+
+#include <QtCharts>
+#include <QImage>
+#include <QPainter>
+#include <QVector>
+#include "weatherdata.h"
+#include "columnarhistory.h"
+
+/**
+ * @brief 气温折线图渲染器
+ * 从 MainWindow::drawTempChart 拆出来，界面和离屏导出共用同一套配色与布局：
+ *  - buildTempChart: 生成 QChart，交给界面上的 QChartView 显示 (只能在主线程用)
+ *  - paintTempChart / renderImage / renderSvg: 纯 QPainter 绘制，
+ *    不依赖任何控件，可以在工作线程里画到 QImage 上
+ */
+class ChartRenderer
+{
+public:
+    // 【新增】气温折线图的数据：X 为日期 (儒略日)，Y 为高/低温
+    // 界面 (QChart) 和离屏 (QPainter) 两条路径都从这里取点和 Y 轴范围，保证画出来一致
+    struct TempSeries {
+        QVector<qint32> days;   // 儒略日，日期无效时为 0
+        QVector<int> highs;
+        QVector<int> lows;
+        int yMin = 0;           // Y 轴范围，已含上下余量
+        int yMax = 0;
+
+        int size() const { return days.size(); }
+        bool isEmpty() const { return days.isEmpty(); }
+        // X 轴标签 "MM/dd"
+        QString label(int i) const;
+    };
+
+    // 【新增】把 DayWeather 列表转成图表数据 (日期只解析这一次)
+    static TempSeries tempSeries(const QList<DayWeather> &list);
+    // 【新增】直接从列式文件的列取点 (儒略日 -> X)，不构造 DayWeather
+    static TempSeries tempSeries(const HistoryColumns &cols);
+
+    // 生成界面用的 QChart (调用方负责交给 QChartView 管理)
+    static QChart *buildTempChart(const QList<DayWeather> &list, const QString &title, bool isNight);
+    static QChart *buildTempChart(const TempSeries &series, const QString &title, bool isNight);
+
+    // 【新增】日内模式：实况观测的温度曲线，X 轴为时间
+    static QChart *buildIntradayChart(const QList<NowObservation> &list, const QString &title, bool isNight);
+
+    // 按日/夜模式给已有图表上色，只改颜色，不动数据
+    static void applyTheme(QChart *chart, bool isNight);
+
+    // 用 QPainter 在 rect 区域内画出同样的折线图 (线程安全，只要 painter 画在 QImage/SVG 上)
+    static void paintTempChart(QPainter *painter, const QRectF &rect,
+                               const TempSeries &series, const QString &title, bool isNight);
+
+    // 离屏渲染成图片
+    static QImage renderImage(const TempSeries &series, const QString &title,
+                              const QSize &size, bool isNight);
+
+    // 离屏渲染成 SVG 文件
+    static bool renderSvg(const QString &filePath, const TempSeries &series,
+                          const QString &title, const QSize &size, bool isNight);
+};
+
+#endif // CHARTRENDERER_H
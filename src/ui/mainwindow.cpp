@@ -2,7 +2,11 @@
 #include "ui_mainwindow.h"
 #include "jsonhelper.h"
 #include <QMessageBox>
+#include <QSettings>
+#include <QMenuBar>
 #include "dbmanager.h"
+#include "themehelper.h"
+#include "chartrenderer.h"
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
@@ -21,10 +25,16 @@ MainWindow::MainWindow(QWidget *parent)
     // 1. 初始化网络管理器
     m_weatherMgr = new WeatherManager(this);
 
+    // 【新增】城市字典 + 输入补全
+    initCompleter();
+
     // 1. 初始化变量 (确保默认为 false)
     m_isNight = false;
+    // 【新增】日/夜两套样式只在这里读取、合并一次，之后切换不再读文件
+    ThemeHelper::install(this);
     // 2. 连接信号
     connect(m_weatherMgr, &WeatherManager::weatherReceived, this, &MainWindow::onWeatherReceived);
+    connect(m_weatherMgr, &WeatherManager::weatherUnchanged, this, &MainWindow::onWeatherUnchanged);
     // 【新增】手动连接，确保只连一次
     connect(ui->btn_Theme, &QPushButton::clicked, this, &MainWindow::switchTheme);
     connect(m_weatherMgr, &WeatherManager::errorOccurred, this, [](QString err){
@@ -46,8 +56,7 @@ MainWindow::~MainWindow()
 
 void MainWindow::on_btn_Search_clicked()
 {
-    QString cityId = ui->lineEdit_City->text().trimmed();
-    if (cityId.isEmpty()) cityId = "beijing"; // 默认
+    QString cityId = currentCityId();
 
     QByteArray cachedData = DBManager::getInstance().getWeatherCache(cityId);
 
@@ -56,12 +65,12 @@ void MainWindow::on_btn_Search_clicked()
 
         TodayWeather weather = JsonHelper::parseWeatherJson(cachedData);
         updateUI(weather);
+        m_shownCityId = cityId;
 
         // --- 【新增代码：补全历史数据】 ---
         // 即使是缓存的数据，也要尝试存入历史表，保证历史表里有数据
-        for (const DayWeather &day : weather.forecast) {
-            DBManager::getInstance().insertHistoryData(cityId, day.date, day.high, day.low);
-        }
+        // (没变化的天会被跳过，不会重复写库)
+        DBManager::getInstance().saveForecast(cityId, weather.forecast, weather.issueDate);
         // -------------------------------
     }
     else {
@@ -80,12 +89,19 @@ void MainWindow::onWeatherReceived(QString cityId, QByteArray data)
     // 1. 解析 & 2. 更新界面 & 3. 存缓存 (原代码不变)
     TodayWeather weather = JsonHelper::parseWeatherJson(data);
     updateUI(weather);
+    m_shownCityId = cityId;
     DBManager::getInstance().cacheWeather(cityId, weather.city, data);
-
-    // 4. 存历史数据 (原代码不变)
-    for (const DayWeather &day : weather.forecast) {
-        DBManager::getInstance().insertHistoryData(cityId, day.date, day.high, day.low);
-    }
+    // 【新增】实况追加进观测日志
+    DBManager::getInstance().appendObservation(cityId, weather);
+    // 【新增】记下城市的行政区划，区域汇总用
+    DBManager::getInstance().saveCityLocation(cityId, weather);
+
+    // 4. 存历史数据 (只写变化了的天)
+    int written = DBManager::getInstance().saveForecast(cityId, weather.forecast, weather.issueDate);
+    HistoryWriteStats stats = DBManager::getInstance().historyWriteStats();
+    qDebug() << "历史写入:" << written << "行; 累计 请求" << stats.requested
+             << "跳过(摘要)" << stats.skippedByDigest << "跳过(SQLite)" << stats.skippedBySqlite
+             << "写入" << stats.written;
 
     // --- 【新增代码：核心修复】 ---
     // 数据存进去了，现在通知表格刷新显示！
@@ -97,6 +113,32 @@ void MainWindow::onWeatherReceived(QString cityId, QByteArray data)
     qDebug() << "历史表已刷新，行数：" << m_model->rowCount();
 }
 
+void MainWindow::onWeatherUnchanged(QString cityId)
+{
+    // 内容没变：库里的缓存和历史已经是最新的，只续期缓存时间
+    DBManager::getInstance().touchWeatherCache(cityId);
+
+    // 界面正在显示的就是这个城市的实况，什么都不用做
+    // (切到历史/24小时视图时会清掉 m_shownCityId，那时要重新显示)
+    if (m_shownCityId == cityId) return;
+
+    // 否则从缓存里取出来显示 (只读，不写历史表)
+    QByteArray cachedData = DBManager::getInstance().getWeatherCache(cityId);
+    if (cachedData.isEmpty()) {
+        // 缓存行已经被清理：手里没有可显示的数据，不按 "没变" 处理，重新完整拉一次
+        qDebug() << "内容未变但缓存已丢失，重新获取 ->" << cityId;
+        m_weatherMgr->forgetPayload(cityId);
+        m_weatherMgr->getWeather(cityId);
+        return;
+    }
+
+    updateUI(JsonHelper::parseWeatherJson(cachedData));
+    m_shownCityId = cityId;
+
+    m_model->setFilter(QString("city_id = '%1'").arg(cityId));
+    m_model->select();
+}
+
 void MainWindow::updateUI(const TodayWeather &weather)
 {
     ui->lbl_Temp->setStyleSheet("font-size: 72px;"); // 恢复大字体显示温度
@@ -114,79 +156,8 @@ void MainWindow::drawTempChart(const QList<DayWeather> &list, QString title)
 {
     if (list.isEmpty()) return;
 
-    // 【核心修改 1】根据日夜模式决定文字颜色
-    // 夜间(true) -> 白色； 日间(false) -> 黑色
-     QColor textColor = m_isNight ? Qt::white : Qt::black;
-    // 网格线颜色也微调一下，日间深一点，夜间淡一点
-    QColor gridColor = m_isNight ? QColor(255, 255, 255, 40) : QColor(0, 0, 0, 40);
-
-    QChart *chart = new QChart();
-    chart->setBackgroundRoundness(0);
-    chart->setBackgroundVisible(false);
-    chart->setTitle(title);
-
-    // 【修改】标题颜色不再写死 Qt::white
-    chart->setTitleBrush(textColor);
-    chart->legend()->setVisible(false);
-
-    QLineSeries *highSeries = new QLineSeries();
-    QLineSeries *lowSeries = new QLineSeries();
-
-    QStringList categories;
-    int minTemp = 100;
-    int maxTemp = -100;
-
-    for (int i = 0; i < list.size(); ++i) {
-        highSeries->append(i, list[i].high);
-        lowSeries->append(i, list[i].low);
-
-        QDate date = QDate::fromString(list[i].date, "yyyy-MM-dd");
-        categories << date.toString("MM/dd");
-
-        if (list[i].low < minTemp) minTemp = list[i].low;
-        if (list[i].high > maxTemp) maxTemp = list[i].high;
-    }
-
-    chart->addSeries(highSeries);
-    chart->addSeries(lowSeries);
-
-    // --- 线条与数值 ---
-    QPen highPen(Qt::red); highPen.setWidth(3); highSeries->setPen(highPen);
-    highSeries->setPointLabelsVisible(true);
-    highSeries->setPointLabelsFormat("@yPoint°");
-    highSeries->setPointLabelsColor(textColor); // 【修改】跟随主题
-
-    QPen lowPen(Qt::blue); lowPen.setWidth(3); lowSeries->setPen(lowPen);
-    lowSeries->setPointLabelsVisible(true);
-    lowSeries->setPointLabelsFormat("@yPoint°");
-    lowSeries->setPointLabelsColor(textColor); // 【修改】跟随主题
-
-    // --- X 轴 ---
-    QBarCategoryAxis *axisX = new QBarCategoryAxis();
-    axisX->append(categories);
-    axisX->setLabelsColor(textColor); // 【修改】跟随主题
-    axisX->setGridLineVisible(false);
-    axisX->setLinePen(QPen(textColor)); // 轴线颜色
-    chart->addAxis(axisX, Qt::AlignBottom);
-    highSeries->attachAxis(axisX);
-    lowSeries->attachAxis(axisX);
-
-    // --- Y 轴 ---
-    QValueAxis *axisY = new QValueAxis();
-    axisY->setRange(minTemp - 3, maxTemp + 3);
-    // 使用标准 Unicode 防止乱码
-    axisY->setLabelFormat("%d C");
-
-    axisY->setLabelsColor(textColor); // 【修改】跟随主题
-
-    // 网格线设为虚线
-    QPen gridPen(gridColor);
-    gridPen.setStyle(Qt::DashLine);
-    axisY->setGridLinePen(gridPen);
-
-    chart->addAxis(axisY, Qt::AlignLeft);
-    highSeries->attachAxis(axisY);
-    lowSeries->attachAxis(axisY);
+    // 【修改】图表构建逻辑已拆到 ChartRenderer，离屏导出也用同一套
+    QChart *chart = ChartRenderer::buildTempChart(list, title, m_isNight);
 
     // 显示
     ui->chartView->setChart(chart);
@@ -197,11 +168,11 @@ void MainWindow::drawTempChart(const QList<DayWeather> &list, QString title)
 void MainWindow::on_btn_History_clicked()
 {
     // 1. 获取输入框的城市 ID
-    QString cityId = ui->lineEdit_City->text().trimmed();
-    if (cityId.isEmpty()) cityId = "beijing"; // 默认
+    QString cityId = currentCityId();
 
-    // 2. 【修改】获取中文名 (如果数据库有缓存，就能显示中文，否则显示拼音)
-    QString cityName = DBManager::getInstance().getCityName(cityId);
+    // 2. 【修改】获取中文名：先查内存字典，字典里没有再查数据库缓存，否则显示拼音
+    const CityInfo *info = m_cityIndex.find(cityId);
+    QString cityName = info ? info->name : DBManager::getInstance().getCityName(cityId);
 
     // 3. 【修改】调用 getRecentHistory (只查过去6天)
     QList<DayWeather> historyList = DBManager::getInstance().getRecentHistory(cityId);
@@ -219,7 +190,8 @@ void MainWindow::on_btn_History_clicked()
     QString startDate = historyList.first().date.mid(5); // "01-06"
     QString endDate = historyList.last().date.mid(5);    // "01-12"
 
-    // 6. 更新界面标签
+    // 6. 更新界面标签 (界面上不再是实况，再搜同一个城市时要重新显示)
+    m_shownCityId.clear();
     ui->lbl_City->setText(cityName); // 显示中文名
 
     // 调整大字显示
@@ -236,38 +208,49 @@ void MainWindow::on_btn_History_clicked()
     drawTempChart(historyList, cityName + " - 历史气温回顾");
 }
 
+void MainWindow::on_btn_Intraday_clicked()
+{
+    QString cityId = currentCityId();
+    const CityInfo *info = m_cityIndex.find(cityId);
+    QString cityName = info ? info->name : DBManager::getInstance().getCityName(cityId);
+
+    QList<NowObservation> list = DBManager::getInstance().getRecentObservations(cityId, 24);
+    if (list.isEmpty()) {
+        QMessageBox::information(this, "暂无数据",
+                                 QString("[%1] 最近 24 小时还没有实况记录。\n\n"
+                                         "每次查询都会记录一次实况，多查几次后再来看走势。").arg(cityName));
+        return;
+    }
+
+    m_shownCityId.clear();
+    ui->lbl_City->setText(cityName);
+    ui->lbl_Temp->setStyleSheet("font-size: 40px;");
+    ui->lbl_Temp->setText("24小时");
+    ui->lbl_Type->setText(QString("最新: %1°C %2").arg(list.last().temp).arg(list.last().text));
+    ui->lbl_Shidu->setText(QString("共 %1 次观测").arg(list.size()));
+
+    ui->tabWidget->setCurrentIndex(0); // 确保在图表页
+
+    QChart *chart = ChartRenderer::buildIntradayChart(list, cityName + " - 24小时实况", m_isNight);
+    ui->chartView->setChart(chart);
+    ui->chartView->setRenderHint(QPainter::Antialiasing);
+}
 
 void MainWindow::switchTheme()
 {
     m_isNight = !m_isNight;
     updateStyle();
 
-    // 【新增】强制刷新图表颜色
-    // 逻辑：如果输入框里有城市，就假装用户又点了一次搜索，或者手动重画
-    QString cityId = ui->lineEdit_City->text();
-    if (!cityId.isEmpty()) {
-        // 重新调用搜索逻辑，这会触发 drawTempChart，使用新的 m_isNight 颜色
-        on_btn_Search_clicked();
-    }
+    // 【修改】只给现有图表换颜色，不再重新搜索 (不查库、不解析、不重建图表)
+    ChartRenderer::applyTheme(ui->chartView->chart(), m_isNight);
 }
 
 // 核心换肤函数
 void MainWindow::updateStyle()
 {
-    // 【修改点】严格按照你截图中的路径来写 (双斜杠)
-    QString qssPath = m_isNight ? "://resources/styles/style_night.qss"
-                                : "://resources/styles/style_day.qss";
-
-    QFile file(qssPath);
-    if (file.open(QFile::ReadOnly)) {
-        QString styleSheet = QLatin1String(file.readAll());
-        qApp->setStyleSheet(styleSheet);
-        file.close();
-        qDebug() << "成功切换主题:" << qssPath;
-    } else {
-        // 如果这里打印了，说明路径还是不对，或者文件没被编译进去
-        qDebug() << "依然找不到文件:" << qssPath;
-    }
+    // 【修改】样式表已在构造时预加载，这里只切换动态属性，没有任何文件 I/O
+    ThemeHelper::applyTheme(this, m_isNight);
+    qDebug() << "成功切换主题:" << (m_isNight ? "night" : "day");
 }
 
 void MainWindow::initModel()
@@ -316,3 +299,100 @@ void MainWindow::initModel()
     m_model->select();
 }
 
+void MainWindow::initCompleter()
+{
+    m_cityIndex.load(":/resources/data/cities.csv");
+    // 【新增】字典里的坐标写进城市位置表 (没变化时不碰库)，就近查询用
+    DBManager::getInstance().saveCityLocations(m_cityIndex.locations());
+
+    // 候选列表由我们自己根据前缀索引填充，QCompleter 只负责弹出和选择
+    m_completerModel = new QStandardItemModel(this);
+    m_completer = new QCompleter(m_completerModel, this);
+    m_completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    m_completer->setCompletionRole(Qt::UserRole); // 选中后填入拼音
+    m_completer->setWidget(ui->lineEdit_City);
+
+    connect(ui->lineEdit_City, &QLineEdit::textEdited, this, &MainWindow::onCityTextEdited);
+    connect(m_completer, QOverload<const QString &>::of(&QCompleter::activated),
+            this, [this](const QString &pinyin) {
+        ui->lineEdit_City->setText(pinyin);
+    });
+
+    // 预取用单独的 WeatherManager，结果只进缓存，不动界面
+    m_prefetchMgr = new WeatherManager(this);
+    connect(m_prefetchMgr, &WeatherManager::weatherReceived, this, &MainWindow::onPrefetchReceived);
+
+    // 停止输入 300ms 后再预取，避免连续敲键时反复发请求
+    m_prefetchTimer = new QTimer(this);
+    m_prefetchTimer->setSingleShot(true);
+    m_prefetchTimer->setInterval(300);
+    connect(m_prefetchTimer, &QTimer::timeout, this, [this]() {
+        // 缓存还新鲜就不用预取了
+        if (!DBManager::getInstance().getWeatherCache(m_prefetchCityId).isEmpty()) return;
+        qDebug() << "预取天气 ->" << m_prefetchCityId;
+        m_prefetchMgr->getWeather(m_prefetchCityId);
+    });
+
+    // 预取会多发上游请求 (免费接口有调用次数限制)，做成可以关掉的选项，下次启动沿用
+    const QString settingsPath = QCoreApplication::applicationDirPath() + "/settings.ini";
+    m_prefetchEnabled = QSettings(settingsPath, QSettings::IniFormat).value("prefetch/enabled", true).toBool();
+
+    QAction *prefetchAction = ui->menubar->addMenu("设置")->addAction("输入时预取天气");
+    prefetchAction->setCheckable(true);
+    prefetchAction->setChecked(m_prefetchEnabled);
+    connect(prefetchAction, &QAction::toggled, this, [this, settingsPath](bool on) {
+        m_prefetchEnabled = on;
+        if (!on) m_prefetchTimer->stop();
+        QSettings(settingsPath, QSettings::IniFormat).setValue("prefetch/enabled", on);
+    });
+}
+
+QString MainWindow::currentCityId() const
+{
+    QString text = ui->lineEdit_City->text().trimmed();
+    if (text.isEmpty()) return "beijing"; // 默认
+
+    // 输入的是中文名或心知ID 时，换成字典里的拼音
+    if (const CityInfo *info = m_cityIndex.find(text)) {
+        return info->pinyin;
+    }
+    return text;
+}
+
+void MainWindow::onCityTextEdited(const QString &text)
+{
+    const QVector<int> hits = m_cityIndex.match(text, 10);
+
+    m_completerModel->clear();
+    for (int index : hits) {
+        const CityInfo &city = m_cityIndex.at(index);
+        QStandardItem *item = new QStandardItem(QString("%1  %2").arg(city.name, city.pinyin));
+        item->setData(city.pinyin, Qt::UserRole);
+        m_completerModel->appendRow(item);
+    }
+
+    if (hits.isEmpty()) {
+        m_completer->popup()->hide();
+        m_prefetchTimer->stop();
+        return;
+    }
+    m_completer->complete();
+
+    // 只剩一个候选时，用户大概率就是要查它，提前拉数据
+    if (m_prefetchEnabled && hits.size() == 1) {
+        m_prefetchCityId = m_cityIndex.at(hits.first()).pinyin;
+        m_prefetchTimer->start();
+    } else {
+        m_prefetchTimer->stop();
+    }
+}
+
+void MainWindow::onPrefetchReceived(QString cityId, QByteArray data)
+{
+    // 只写缓存和历史，点搜索时直接命中缓存
+    TodayWeather weather = JsonHelper::parseWeatherJson(data);
+    DBManager::getInstance().cacheWeather(cityId, weather.city, data);
+    DBManager::getInstance().appendObservation(cityId, weather);
+    DBManager::getInstance().saveCityLocation(cityId, weather);
+    DBManager::getInstance().saveForecast(cityId, weather.forecast, weather.issueDate);
+}
@@ -4,8 +4,12 @@
 #include <QMainWindow>
 #include <QtCharts> // 引入图表库
 #include <QSqlTableModel>
+#include <QCompleter>
+#include <QStandardItemModel>
+#include <QTimer>
 #include "weathermanager.h"
 #include "weatherdata.h"
+#include "cityindex.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -25,15 +29,24 @@ private slots:
 
     // 接收到天气数据的槽函数
     void onWeatherReceived(QString cityId, QByteArray data);
+    // 【新增】网络数据与上次相同
+    void onWeatherUnchanged(QString cityId);
     void on_btn_History_clicked();
+    // 【新增】日内模式：最近 24 小时实况温度
+    void on_btn_Intraday_clicked();
 
 
     void switchTheme();
 
+    // 【新增】输入框补全 + 预取
+    void onCityTextEdited(const QString &text);
+    void onPrefetchReceived(QString cityId, QByteArray data);
+
 private:
     Ui::MainWindow *ui;
     WeatherManager *m_weatherMgr;
     bool m_isNight; // 记录当前是否是夜间模式
+    QString m_shownCityId; // 【新增】界面上当前显示的城市
     void updateStyle(); // 切换样式的辅助函数
 
     // 【核心】更新 UI 显示
@@ -45,5 +58,20 @@ private:
     QSqlTableModel *m_model; // 数据模型
     void initModel();        // 初始化模型的函数
 
+    // 【新增】城市字典 + 输入补全
+    CityIndex m_cityIndex;
+    QCompleter *m_completer;
+    QStandardItemModel *m_completerModel;
+    void initCompleter();
+    // 把输入框内容 (拼音/中文名/ID) 统一转成查询用的 city_id
+    QString currentCityId() const;
+
+    // 【新增】补全唯一时，提前把该城市的天气拉下来写进缓存
+    // 开关在 "设置" 菜单里，保存在程序目录下的 settings.ini (prefetch/enabled)
+    bool m_prefetchEnabled = true;
+    WeatherManager *m_prefetchMgr;
+    QTimer *m_prefetchTimer;
+    QString m_prefetchCityId;
+
 };
 #endif // MAINWINDOW_H
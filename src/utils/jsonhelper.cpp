@@ -1,5 +1,362 @@
 #include "jsonhelper.h"
 #include <QDateTime> // 记得包含这个
+#include <QThreadPool>
+#include <QSemaphore>
+#include <memory_resource>
+#include <string_view>
+#include <charconv>
+#include <cctype>
+#include <cstddef>
+
+namespace {
+
+// 一个工作任务 (一段连续的 payload) 的解析结果
+struct ChunkResult {
+    QVector<CompactDay> days;
+    QVector<int> counts;      // 每个 payload 的天数，-1 表示解析失败
+    QVector<qint32> issueDays; // 每个 payload 的发布日 (儒略日)，0 表示未知
+    QStringList names;
+};
+
+/**
+ * 批量回填专用的 JSON 扫描器：按字节把 payload 走一遍，只取 location.name、daily_update
+ * 和 daily[].date/high/low，其余的值只跳过、不解码，不构造 QJsonDocument 和 QString。
+ * 字符串一般直接指向输入 (string_view)；带转义的才解码，写进调用方给的内存池。
+ * 格式不合法 (括号不配对、字符串没结束、结尾有多余内容等) 时 scan() 返回 false。
+ */
+class PayloadScanner
+{
+public:
+    struct Result {
+        std::string_view name;
+        std::string_view issued;    // daily_update
+        int days = 0;               // 追加到 days 里的天数
+    };
+
+    PayloadScanner(const QByteArray &json, std::pmr::memory_resource *arena)
+        : m_p(json.constData()), m_end(json.constData() + json.size()), m_arena(arena) {}
+
+    bool scan(Result &out, std::pmr::vector<CompactDay> &days)
+    {
+        skipSpace();
+        if (!consume('{')) return false;
+        if (!consume('}')) {
+            do {
+                std::string_view key;
+                if (!readKey(key)) return false;
+
+                bool ok;
+                if (key == "location") ok = scanLocation(out);
+                else if (key == "daily_update") ok = readString(out.issued);
+                else if (key == "daily") ok = scanDaily(out, days);
+                else ok = skipValue(0);
+                if (!ok) return false;
+            } while (consume(','));
+            if (!consume('}')) return false;
+        }
+        skipSpace();
+        return m_p == m_end;
+    }
+
+private:
+    static const int MAX_DEPTH = 64;
+
+    void skipSpace()
+    {
+        while (m_p < m_end && (*m_p == ' ' || *m_p == '\n' || *m_p == '\r' || *m_p == '\t')) ++m_p;
+    }
+
+    bool consume(char c)
+    {
+        skipSpace();
+        if (m_p == m_end || *m_p != c) return false;
+        ++m_p;
+        return true;
+    }
+
+    bool readKey(std::string_view &key) { return readString(key) && consume(':'); }
+
+    bool readString(std::string_view &out)
+    {
+        if (!consume('"')) return false;
+        const char *begin = m_p;
+        bool escaped = false;
+        while (m_p < m_end && *m_p != '"') {
+            if (uchar(*m_p) < 0x20) return false;
+            if (*m_p == '\\') {
+                escaped = true;
+                if (++m_p == m_end) return false;
+            }
+            ++m_p;
+        }
+        if (m_p == m_end) return false;
+        const char *stop = m_p++;
+
+        if (!escaped) {
+            out = std::string_view(begin, size_t(stop - begin));
+            return true;
+        }
+        return unescape(begin, stop, out);
+    }
+
+    // 解码后的长度不会超过原文，直接从内存池要一块原文长度的空间
+    bool unescape(const char *begin, const char *stop, std::string_view &out)
+    {
+        char *buf = static_cast<char*>(m_arena->allocate(size_t(stop - begin), 1));
+        char *w = buf;
+        for (const char *r = begin; r < stop; ++r) {
+            if (*r != '\\') {
+                *w++ = *r;
+                continue;
+            }
+            switch (*++r) {
+            case '"': case '\\': case '/': *w++ = *r; break;
+            case 'b': *w++ = '\b'; break;
+            case 'f': *w++ = '\f'; break;
+            case 'n': *w++ = '\n'; break;
+            case 'r': *w++ = '\r'; break;
+            case 't': *w++ = '\t'; break;
+            case 'u': {
+                uint cp;
+                if (!readHex4(r, stop, cp)) return false;
+                // 代理对
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    uint low;
+                    if (r + 2 >= stop || r[1] != '\\' || r[2] != 'u') return false;
+                    r += 2;
+                    if (!readHex4(r, stop, low) || low < 0xDC00 || low > 0xDFFF) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                w = appendUtf8(w, cp);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        out = std::string_view(buf, size_t(w - buf));
+        return true;
+    }
+
+    // r 指向 'u'，成功时指向最后一个十六进制位
+    static bool readHex4(const char *&r, const char *stop, uint &cp)
+    {
+        if (stop - r < 5) return false;
+        cp = 0;
+        for (int i = 1; i <= 4; ++i) {
+            const char c = r[i];
+            cp <<= 4;
+            if (c >= '0' && c <= '9') cp |= uint(c - '0');
+            else if (c >= 'a' && c <= 'f') cp |= uint(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') cp |= uint(c - 'A' + 10);
+            else return false;
+        }
+        r += 4;
+        return true;
+    }
+
+    // \uXXXX 最多 6 个原文字符，编成 UTF-8 最多 4 字节 (代理对 12 个原文字符编成 4 字节)
+    static char *appendUtf8(char *w, uint cp)
+    {
+        if (cp < 0x80) {
+            *w++ = char(cp);
+        } else if (cp < 0x800) {
+            *w++ = char(0xC0 | (cp >> 6));
+            *w++ = char(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            *w++ = char(0xE0 | (cp >> 12));
+            *w++ = char(0x80 | ((cp >> 6) & 0x3F));
+            *w++ = char(0x80 | (cp & 0x3F));
+        } else {
+            *w++ = char(0xF0 | (cp >> 18));
+            *w++ = char(0x80 | ((cp >> 12) & 0x3F));
+            *w++ = char(0x80 | ((cp >> 6) & 0x3F));
+            *w++ = char(0x80 | (cp & 0x3F));
+        }
+        return w;
+    }
+
+    // 数字和 true/false/null 原样取出 (不区分类型，高低温两种写法都可能出现)
+    bool readScalar(std::string_view &out)
+    {
+        skipSpace();
+        const char *begin = m_p;
+        while (m_p < m_end && (std::isalnum(uchar(*m_p)) || *m_p == '-' || *m_p == '+' || *m_p == '.')) ++m_p;
+        if (m_p == begin) return false;
+        out = std::string_view(begin, size_t(m_p - begin));
+        return true;
+    }
+
+    bool skipValue(int depth)
+    {
+        if (depth > MAX_DEPTH) return false;
+        skipSpace();
+        if (m_p == m_end) return false;
+
+        std::string_view ignored;
+        switch (*m_p) {
+        case '"':
+            return readString(ignored);
+        case '{':
+            ++m_p;
+            if (consume('}')) return true;
+            do {
+                if (!readKey(ignored) || !skipValue(depth + 1)) return false;
+            } while (consume(','));
+            return consume('}');
+        case '[':
+            ++m_p;
+            if (consume(']')) return true;
+            do {
+                if (!skipValue(depth + 1)) return false;
+            } while (consume(','));
+            return consume(']');
+        default:
+            return readScalar(ignored);
+        }
+    }
+
+    // 字符串或数字都接受，取出原文
+    bool readText(std::string_view &out)
+    {
+        skipSpace();
+        return (m_p < m_end && *m_p == '"') ? readString(out) : readScalar(out);
+    }
+
+    bool scanLocation(Result &out)
+    {
+        skipSpace();
+        if (m_p == m_end || *m_p != '{') return skipValue(1);
+        ++m_p;
+        if (consume('}')) return true;
+        do {
+            std::string_view key;
+            if (!readKey(key)) return false;
+            if (!(key == "name" ? readText(out.name) : skipValue(2))) return false;
+        } while (consume(','));
+        return consume('}');
+    }
+
+    bool scanDaily(Result &out, std::pmr::vector<CompactDay> &days)
+    {
+        skipSpace();
+        if (m_p == m_end || *m_p != '[') return skipValue(1);
+        ++m_p;
+        if (consume(']')) return true;
+        do {
+            skipSpace();
+            if (m_p == m_end || *m_p != '{') {
+                if (!skipValue(2)) return false;
+                continue;
+            }
+            ++m_p;
+            std::string_view date, high, low;
+            if (!consume('}')) {
+                do {
+                    std::string_view key;
+                    if (!readKey(key)) return false;
+                    bool ok;
+                    if (key == "date") ok = readText(date);
+                    else if (key == "high") ok = readText(high);
+                    else if (key == "low") ok = readText(low);
+                    else ok = skipValue(3);
+                    if (!ok) return false;
+                } while (consume(','));
+                if (!consume('}')) return false;
+            }
+
+            const qint64 day = julianDayOf(date);
+            if (day == 0) continue;
+            days.push_back({ qint32(day), qint16(toInt(high)), qint16(toInt(low)) });
+            ++out.days;
+        } while (consume(','));
+        return consume(']');
+    }
+
+public:
+    // "yyyy-MM-dd" (后面可以跟 "T..." 时间部分) -> 儒略日，无效返回 0
+    static qint64 julianDayOf(std::string_view s)
+    {
+        if (s.size() < 10 || s[4] != '-' || s[7] != '-' || (s.size() > 10 && s[10] != 'T')) return 0;
+        int parts[3] = { 0, 0, 0 };
+        const int starts[3] = { 0, 5, 8 };
+        const int lengths[3] = { 4, 2, 2 };
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < lengths[i]; ++j) {
+                const char c = s[size_t(starts[i] + j)];
+                if (c < '0' || c > '9') return 0;
+                parts[i] = parts[i] * 10 + (c - '0');
+            }
+        }
+        const QDate date(parts[0], parts[1], parts[2]);
+        return date.isValid() ? date.toJulianDay() : 0;
+    }
+
+    // 和 QString::toInt 一样，不是整数时返回 0
+    static int toInt(std::string_view s)
+    {
+        int value = 0;
+        const char *first = s.data();
+        const char *last = first + s.size();
+        if (first != last && *first == '+') ++first;
+        auto r = std::from_chars(first, last, value);
+        return (r.ec == std::errc() && r.ptr == last) ? value : 0;
+    }
+
+private:
+    const char *m_p;
+    const char *m_end;
+    std::pmr::memory_resource *m_arena;
+};
+
+void parseChunk(const QList<RawPayload> &payloads, int begin, int end, ChunkResult &out)
+{
+    // 本任务的临时数据 (扫描结果、解码后的字符串) 都从这块内存里顺序分配，不走全局分配器，
+    // 任务结束时整体丢弃 (超出 32KB 时 monotonic_buffer_resource 会向上游再要一大块，同样一次释放)
+    alignas(std::max_align_t) char buffer[32 * 1024];
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+    std::pmr::vector<CompactDay> days(&arena);
+    std::pmr::vector<int> counts(&arena);
+    std::pmr::vector<qint32> issueDays(&arena);
+    days.reserve(size_t(end - begin) * 4);
+    counts.reserve(size_t(end - begin));
+    issueDays.reserve(size_t(end - begin));
+    out.names.reserve(end - begin);
+
+    for (int i = begin; i < end; ++i) {
+        PayloadScanner::Result r;
+        const size_t daysBefore = days.size();
+        PayloadScanner scanner(payloads[i].json, &arena);
+        if (!scanner.scan(r, days)) {
+            days.resize(daysBefore);   // 扫到一半失败，丢掉这个 payload 已经追加的天
+            counts.push_back(-1);
+            issueDays.push_back(0);
+            out.names.append(QString());
+            continue;
+        }
+
+        // 城市名是唯一要交出去的字符串，这里才转成 QString
+        out.names.append(QString::fromUtf8(r.name.data(), qsizetype(r.name.size())));
+        // 发布日取预报的发布时间 (日期部分就是当地日期)；回填的旧数据不能当成今天发布的
+        issueDays.push_back(qint32(PayloadScanner::julianDayOf(r.issued)));
+        counts.push_back(r.days);
+    }
+
+    // 拷贝出内存池 (各一次分配)，之后 arena 随栈帧一起释放
+    out.days = QVector<CompactDay>(days.begin(), days.end());
+    out.counts = QVector<int>(counts.begin(), counts.end());
+    out.issueDays = QVector<qint32>(issueDays.begin(), issueDays.end());
+}
+
+// 批量解析专用线程池：不占全局线程池，调用方本身在全局池里 (读连接池任务、导出任务) 时
+// 也不会因为等自己排在后面的任务而卡死
+QThreadPool *parsePool()
+{
+    static QThreadPool pool;
+    return &pool;
+}
+
+} // namespace
 
 JsonHelper::JsonHelper() {}
 
@@ -22,6 +379,9 @@ TodayWeather JsonHelper::parseWeatherJson(const QByteArray &data)
         QJsonObject loc = root["location"].toObject();
         today.city = loc["name"].toString();
         today.cityId = loc["id"].toString();
+        // 【新增】行政区划和国家，区域汇总用
+        today.path = loc["path"].toString();
+        today.country = loc["country"].toString();
     }
 
     // 2. 解析实况天气 (now)
@@ -49,6 +409,15 @@ TodayWeather JsonHelper::parseWeatherJson(const QByteArray &data)
         today.date = QDateTime::currentDateTime().toString("yyyy-MM-dd");
     }
 
+    // 【新增】实况观测时间
+    if (root.contains("last_update")) {
+        today.updateTime = root["last_update"].toString();
+    }
+    // 【新增】预报发布日 (预报接口自己的 last_update，不是实况的观测时间)
+    if (root.contains("daily_update")) {
+        today.issueDate = QDateTime::fromString(root["daily_update"].toString(), Qt::ISODate).date();
+    }
+
     // 3. 解析未来天气 (daily)
     if (root.contains("daily") && root["daily"].isArray()) {
         QJsonArray dailyArr = root["daily"].toArray();
@@ -83,3 +452,58 @@ TodayWeather JsonHelper::parseWeatherJson(const QByteArray &data)
 
     return today;
 }
+
+ParsedBatch JsonHelper::parseWeatherBatch(const QList<RawPayload> &payloads)
+{
+    ParsedBatch batch;
+    const int total = payloads.size();
+    if (total == 0) {
+        batch.dayOffsets.append(0);
+        return batch;
+    }
+
+    // 1. 按线程数切块，并行解析 (调用线程自己也解析第一块)
+    QThreadPool *pool = parsePool();
+    const int chunks = qMin(total, pool->maxThreadCount() + 1);
+    const int perChunk = (total + chunks - 1) / chunks;
+
+    QVector<ChunkResult> results((total + perChunk - 1) / perChunk);
+    QSemaphore done;
+
+    for (int c = 1; c < results.size(); ++c) {
+        const int begin = c * perChunk;
+        const int end = qMin(total, begin + perChunk);
+        ChunkResult *slot = &results[c];  // 每个任务写自己的槽位，不需要加锁
+        pool->start([&payloads, begin, end, slot, &done]() {
+            parseChunk(payloads, begin, end, *slot);
+            done.release();
+        });
+    }
+    parseChunk(payloads, 0, qMin(total, perChunk), results[0]);
+    done.acquire(results.size() - 1);
+
+    // 2. 按输入顺序合并
+    int dayCount = 0;
+    for (const ChunkResult &r : std::as_const(results)) dayCount += r.days.size();
+
+    batch.cityIds.reserve(total);
+    batch.cityNames.reserve(total);
+    batch.ok.reserve(total);
+    batch.issueDays.reserve(total);
+    batch.dayOffsets.reserve(total + 1);
+    batch.days.reserve(dayCount);
+    batch.dayOffsets.append(0);
+
+    int index = 0;
+    for (const ChunkResult &r : std::as_const(results)) {
+        batch.days += r.days;
+        for (int i = 0; i < r.counts.size(); ++i, ++index) {
+            batch.cityIds.append(payloads[index].cityId);
+            batch.cityNames.append(r.names[i]);
+            batch.ok.append(r.counts[i] >= 0);
+            batch.issueDays.append(r.issueDays[i]);
+            batch.dayOffsets.append(batch.dayOffsets.last() + qMax(0, r.counts[i]));
+        }
+    }
+    return batch;
+}
@@ -16,6 +16,12 @@ public:
 
     // 核心函数：把字节数组解析为 WeatherData 结构体
     static TodayWeather parseWeatherJson(const QByteArray &data);
+
+    // 【新增】批量解析 (回填/多城市刷新用)：在线程池里并行解析，只提取预报的日期和高低温，
+    // 不走 QJsonDocument，直接扫描字节；每个工作任务的临时数据放在自己的内存池 (pmr) 里，
+    // 写自己的输出槽位，最后按输入顺序拼接
+    // 结果可直接交给 DBManager::saveParsedBatch 批量写库
+    static ParsedBatch parseWeatherBatch(const QList<RawPayload> &payloads);
 };
 
 #endif // JSONHELPER_H
@@ -0,0 +1,98 @@
+#include "themehelper.h"
+#include <QFile>
+#include <QStyle>
+#include <QRegularExpression>
+#include <QDebug>
+
+void ThemeHelper::install(QWidget *root)
+{
+    // 只在第一次调用时读文件 + 改写，之后直接复用
+    static const QString combined =
+        scopeStyleSheet(loadQss("://resources/styles/style_day.qss"), "day") +
+        scopeStyleSheet(loadQss("://resources/styles/style_night.qss"), "night");
+
+    root->setProperty("theme", "day");
+    root->setStyleSheet(combined);
+}
+
+void ThemeHelper::applyTheme(QWidget *root, bool isNight)
+{
+    root->setProperty("theme", isNight ? "night" : "day");
+
+    // 动态属性变化后 Qt 不会自动重算样式，需要手动 unpolish/polish
+    // 范围只限本窗口的控件，不会像 qApp->setStyleSheet 那样波及整个程序
+    QStyle *style = root->style();
+    style->unpolish(root);
+    style->polish(root);
+
+    const QList<QWidget*> children = root->findChildren<QWidget*>();
+    for (QWidget *w : children) {
+        w->style()->unpolish(w);
+        w->style()->polish(w);
+    }
+    root->update();
+}
+
+QColor ThemeHelper::chartTextColor(bool isNight)
+{
+    // 夜间(true) -> 白色； 日间(false) -> 黑色
+    return isNight ? QColor(Qt::white) : QColor(Qt::black);
+}
+
+QColor ThemeHelper::chartGridColor(bool isNight)
+{
+    // 网格线颜色也微调一下，日间深一点，夜间淡一点
+    return isNight ? QColor(255, 255, 255, 40) : QColor(0, 0, 0, 40);
+}
+
+QString ThemeHelper::loadQss(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        qDebug() << "找不到样式文件:" << path;
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll());
+}
+
+QString ThemeHelper::scopeStyleSheet(const QString &qss, const QString &theme)
+{
+    // 1. 去掉注释，避免注释里的逗号、大括号干扰解析
+    static const QRegularExpression commentRe("/\\*.*?\\*/",
+                                              QRegularExpression::DotMatchesEverythingOption);
+    QString src = qss;
+    src.remove(commentRe);
+
+    // 2. 逐条规则改写选择器
+    // 例: "QLabel, QPushButton { ... }"
+    //  -> "QMainWindow[theme="day"] QLabel, QMainWindow[theme="day"] QPushButton { ... }"
+    const QString scope = QString("QMainWindow[theme=\"%1\"]").arg(theme);
+    QString out;
+    int pos = 0;
+    while (true) {
+        int open = src.indexOf('{', pos);
+        if (open < 0) break;
+        int close = src.indexOf('}', open);
+        if (close < 0) break;
+
+        QStringList scoped;
+        const QStringList selectors = src.mid(pos, open - pos).split(',', Qt::SkipEmptyParts);
+        for (const QString &raw : selectors) {
+            QString sel = raw.trimmed();
+            if (sel.isEmpty()) continue;
+
+            if (sel.startsWith("QMainWindow")) {
+                // 窗口本身：把属性直接加在 QMainWindow 上
+                scoped << scope + sel.mid(QString("QMainWindow").size());
+            } else {
+                scoped << scope + " " + sel;
+            }
+        }
+
+        if (!scoped.isEmpty()) {
+            out += scoped.join(", ") + " " + src.mid(open, close - open + 1) + "\n";
+        }
+        pos = close + 1;
+    }
+    return out;
+}
@@ -0,0 +1,34 @@
+#ifndef THEMEHELPER_H
+#define THEMEHELPER_H
+
+#include <QWidget>
+#include <QString>
+#include <QColor>
+
+/**
+ * @brief 主题切换辅助类
+ * 启动时一次性读取日/夜两套 QSS，改写成按动态属性 theme 区分的合并样式表，
+ * 之后切换主题只改属性并重新 polish 本窗口的控件，不再读文件、不再设置全局 qApp 样式表。
+ */
+class ThemeHelper
+{
+public:
+    // 启动时调用一次：把合并后的样式表挂到 root 上
+    static void install(QWidget *root);
+
+    // 切换主题：只修改 root 的 theme 属性，并重新 polish root 及其子控件
+    static void applyTheme(QWidget *root, bool isNight);
+
+    // 图表用的颜色 (图表不受 QSS 控制，需要手动上色)
+    static QColor chartTextColor(bool isNight);
+    static QColor chartGridColor(bool isNight);
+
+private:
+    // 读取资源中的 QSS 文件
+    static QString loadQss(const QString &path);
+
+    // 给每条选择器加上 QMainWindow[theme="xxx"] 前缀
+    static QString scopeStyleSheet(const QString &qss, const QString &theme);
+};
+
+#endif // THEMEHELPER_H